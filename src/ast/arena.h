@@ -0,0 +1,58 @@
+#ifndef ARENA_H_INCLUDE
+#define ARENA_H_INCLUDE
+
+#include <llvm/Support/Allocator.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator for the syntax tree of one translation unit. Allocation is
+// a pointer bump; everything is destroyed and freed at once together with
+// the arena, in the reverse order of construction.
+class YacArena {
+public:
+    YacArena() = default;
+    YacArena(const YacArena &) = delete;
+    YacArena &operator = (const YacArena &) = delete;
+    ~YacArena() {
+        destroy();
+    }
+
+    template <typename T, typename... Args>
+    T *make(Args &&... args) {
+        void *memory = m_allocator.Allocate(sizeof(T), alignof(T));
+        T *object = new (memory) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value)
+            m_destructors.push_back(Destructor{object, &destroy<T>});
+        return object;
+    }
+
+    // destroys everything, the memory is kept for reuse
+    void reset() {
+        destroy();
+        m_destructors.clear();
+        m_allocator.Reset();
+    }
+
+    size_t bytesAllocated() const {
+        return m_allocator.getBytesAllocated();
+    }
+private:
+    struct Destructor {
+        void *object;
+        void (*destroy)(void *object);
+    };
+    template <typename T>
+    static void destroy(void *object) {
+        static_cast<T *>(object)->~T();
+    }
+    void destroy() {
+        for (auto iter = m_destructors.rbegin(); iter != m_destructors.rend(); ++iter)
+            iter->destroy(iter->object);
+    }
+
+    llvm::BumpPtrAllocator m_allocator;
+    std::vector<Destructor> m_destructors;
+};
+
+#endif
@@ -3,12 +3,24 @@
 #include "declaration.h"
 #include "context.h"
 
-unsigned int line_number = 1;
-unsigned int column_number = 1;
-std::string input("<stdin>"); // NOLINT
+static thread_local YacTranslationUnit *g_unit = nullptr;
 
-YacScope *root = new YacScope; // NOLINT
-static std::vector<YacScope *> scopes{root}; // NOLINT
+YacPos::YacPos()
+    : m_location(g_unit ? g_unit->sources().location() : 0) {}
+
+std::ostream &operator << (std::ostream &out, const YacPos &pos) {
+    if (!g_unit)
+        return out << "<unknown>";
+    llvm::StringRef file;
+    unsigned int line, column;
+    g_unit->sources().resolve(pos.location(), file, line, column);
+    out.write(file.data(), file.size()) << ':' << line << ':' << column;
+    return out;
+}
+
+std::ostream &diagnostics() {
+    return g_unit ? g_unit->diagnostics() : std::cerr;
+}
 
 llvm::Value *YacSyntaxTreeNodeList::generate(YacSemanticAnalyzer &context)
 {
@@ -23,63 +35,84 @@ std::ostream &operator << (std::ostream &out, const YacSyntaxError &err) {
 }
 
 std::ostream &operator << (std::ostream &out, const YacSemanticError &err) {
+    if (g_unit)
+        g_unit->addError();
     auto source = err.source();
     out << source->pos << ": " << err.name() << " error: " << err.what();
     return out;
 }
 
-void YacScope::addToScope(YacDeclaration *declaration)
-{
-    assert(declaration && declaration->identifier);
-    // TODO redeclaration
-    if (declarations.find(*declaration->identifier) != declarations.end())
-        std::cerr << "yac: " << YacSyntaxError("identifier redeclaration") << std::endl;
-    declarations.insert(std::make_pair(*declaration->identifier, declaration));
+YacTranslationUnit::YacTranslationUnit(llvm::LLVMContext &context)
+    : m_analyzer(nullptr), m_context(context), m_types(context), m_root(make<YacScope>()), m_scopes{m_root}, m_diagnostics(&std::cerr), m_errors(0) {}
+
+YacTranslationUnit *YacTranslationUnit::current() {
+    return g_unit;
+}
+
+void YacTranslationUnit::setCurrent(YacTranslationUnit *unit) {
+    g_unit = unit;
 }
 
-void pushScope(YacScope *scope) {
-    scopes.push_back(scope);
+void YacTranslationUnit::pushScope(YacScope *scope) {
+    m_scopes.push_back(scope);
+    m_symbols.pushScope();
 #ifdef DEBUG_SCOPE
-    std::cerr << "yac: debug: " << YacPos() << (" { #" + std::to_string(scopes.size() - 1)) << std::endl;
+    std::cerr << "yac: debug: " << YacPos() << (" { #" + std::to_string(m_scopes.size() - 1)) << std::endl;
 #endif
 }
-YacScope *topScope() {
-    return scopes.empty() ? nullptr : scopes.back();
+YacScope *YacTranslationUnit::topScope() {
+    return m_scopes.empty() ? nullptr : m_scopes.back();
 }
-void popScope() {
-    assert(!scopes.empty());
-    scopes.pop_back();
+void YacTranslationUnit::popScope() {
+    assert(!m_scopes.empty());
+    m_scopes.pop_back();
+    m_symbols.popScope();
 #ifdef DEBUG_SCOPE
-    std::cerr << "yac: debug: " << YacPos() << (" } #" + std::to_string(scopes.size())) << std::endl;
+    std::cerr << "yac: debug: " << YacPos() << (" } #" + std::to_string(m_scopes.size())) << std::endl;
 #endif
 }
 
-bool addToTopScope(YacDeclaration *declaration)
+void YacTranslationUnit::addExternalDeclaration(YacDeclarationList *declarations)
+{
+    if (!m_analyzer) {
+        for (auto node: declarations->children)
+            m_root->addNode(node);
+        return;
+    }
+    for (auto node: declarations->children) {
+        node->generate(*m_analyzer);
+        // the body lives in the transient arena, which is about to be reset
+        auto function = dynamic_cast<YacFunctionDefinition *>(node);
+        if (function) {
+            function->params = nullptr;
+            function->body = nullptr;
+        }
+    }
+    m_transient_arena.reset();
+}
+
+bool YacTranslationUnit::addToTopScope(YacDeclaration *declaration)
 {
     auto scope = topScope();
     if (declaration && declaration->identifier && scope) {
-        scope->addToScope(declaration);
+        // TODO redeclaration
+        if (!m_symbols.add(declaration->identifier, declaration))
+            diagnostics() << "yac: " << YacSyntaxError("identifier redeclaration") << std::endl;
 #ifdef DEBUG_SCOPE
-        std::cerr << "yac: debug: " << YacPos() << (" add " + *declaration->identifier + " #" + std::to_string(scopes.size())) << std::endl;
+        std::cerr << "yac: debug: " << YacPos() << (" add " + declaration->identifier->str().str() + " #" + std::to_string(m_scopes.size())) << std::endl;
 #endif
     }
     return false;
 }
 
 
-YacDeclaration *findInScopes(const std::string &identifier) {
-    for (auto iter = scopes.rbegin(); iter < scopes.rend(); ++iter) {
-        if (!*iter)
-            continue;
-        auto &declarations = (*iter)->declarations;
-        auto search = declarations.find(identifier);
-        if (search != declarations.end()) {
+YacDeclaration *YacTranslationUnit::findInScopes(const YacIdentifier *identifier) {
+    unsigned int depth;
+    auto declaration = m_symbols.find(identifier, &depth);
 #ifdef DEBUG_SCOPE
-            std::cerr << "yac: debug: " << YacPos() << (" hit " + identifier + " #" + std::to_string((iter - scopes.rbegin()))) << std::endl;
+    if (declaration)
+        std::cerr << "yac: debug: " << YacPos() << (" hit " + identifier->str().str() + " #" + std::to_string(m_symbols.depth() - depth)) << std::endl;
 #endif
-            return search->second;
-        }
-    }
-    return nullptr;
+    return declaration;
 }
 
@@ -2,37 +2,42 @@
 #define AST_H_INCLUDE
 
 #include <llvm/IR/Value.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/ADT/DenseMap.h>
 #include <vector>
 #include <exception>
+#include <ostream>
 #include <string>
 #include <stack>
 #include <map>
+#include "arena.h"
+#include "identifier.h"
+#include "symbol.h"
+#include "types.h"
+#include "../syntax/source.h"
 
 // #define DEBUG_SCOPE
 
-extern std::string input;
-extern unsigned int line_number;
-extern unsigned int column_number;
-
+// The current position of the scanner, resolved through the source manager
+// of the current translation unit on output
 class YacPos {
     friend std::ostream &operator << (std::ostream &out, const YacPos &pos);
 public:
-    YacPos() {
-        m_i = input;
-        m_l = line_number;
-        m_c = column_number;
+    YacPos();
+    uint32_t location() const {
+        return m_location;
     }
 private:
-    std::string m_i;
-    unsigned int m_l, m_c;
+    uint32_t m_location;
 };
 
-inline std::ostream &operator << (std::ostream &out, const YacPos &pos) {
-    out << pos.m_i << ':' << pos.m_l << ':' << pos.m_c;
-    return out;
-}
+std::ostream &operator << (std::ostream &out, const YacPos &pos);
+
+// where the current translation unit reports errors, std::cerr by default
+std::ostream &diagnostics();
 
 class YacDeclaration;
+class YacDeclarationList;
 class YacSemanticAnalyzer;
 class YacScope;
 
@@ -83,19 +88,92 @@ std::ostream &operator << (std::ostream &out, const YacSyntaxError &err);
 std::ostream &operator << (std::ostream &out, const YacSemanticError &err);
 
 
-class YacScope: public YacSyntaxTreeNodeList {
+// a block, the names it declares are kept in the symbol table of the unit
+class YacScope: public YacSyntaxTreeNodeList {};
+
+
+// All the front-end state of one translation unit. Every compilation owns
+// one, so that several translation units can be compiled at the same time
+// on different threads.
+class YacTranslationUnit {
 public:
-    void addToScope(YacDeclaration *declaration);
-    std::map<std::string, YacDeclaration *> declarations;
-};
+    explicit YacTranslationUnit(llvm::LLVMContext &context);
+
+    llvm::LLVMContext &context() {
+        return m_context;
+    }
+    YacSourceManager &sources() {
+        return m_sources;
+    }
+    YacIdentifierTable &identifiers() {
+        return m_identifiers;
+    }
+    YacTypeContext &types() {
+        return m_types;
+    }
+    YacScope *root() {
+        return m_root;
+    }
+    // allocates a syntax tree object living as long as the translation unit,
+    // or only until the end of the current external declaration if streaming
+    template <typename T, typename... Args>
+    T *make(Args &&... args) {
+        return (m_analyzer ? m_transient_arena : m_arena).make<T>(std::forward<Args>(args)...);
+    }
+    // allocates a declaration of the innermost scope; the ones at file scope
+    // always live as long as the translation unit since later external
+    // declarations still refer to them
+    template <typename T, typename... Args>
+    T *makeDeclaration(Args &&... args) {
+        if (m_scopes.size() == 1)
+            return m_arena.make<T>(std::forward<Args>(args)...);
+        return make<T>(std::forward<Args>(args)...);
+    }
 
+    // In streaming mode every external declaration is generated with
+    // `analyzer' as soon as it is parsed, and its syntax tree is released
+    // right after. Otherwise they are collected in the root scope.
+    void setStreaming(YacSemanticAnalyzer *analyzer) {
+        m_analyzer = analyzer;
+    }
+    void addExternalDeclaration(YacDeclarationList *declarations);
+    std::ostream &diagnostics() {
+        return *m_diagnostics;
+    }
+    void setDiagnostics(std::ostream *diagnostics) {
+        m_diagnostics = diagnostics;
+    }
+    // the number of semantic errors printed, which fail the compilation even
+    // though they were not thrown
+    unsigned int errors() const {
+        return m_errors;
+    }
+    void addError() {
+        ++m_errors;
+    }
 
-extern YacScope *root;
+    void pushScope(YacScope *scope = nullptr);
+    YacScope *topScope();
+    void popScope();
+    bool addToTopScope(YacDeclaration *declaration);
+    YacDeclaration *findInScopes(const YacIdentifier *identifier);
 
-void pushScope(YacScope *scope = nullptr);
-YacScope *topScope();
-void popScope();
-bool addToTopScope(YacDeclaration *declaration);
-YacDeclaration *findInScopes(const std::string &identifier);
+    // the translation unit the calling thread is working on, used to
+    // position and to print diagnostics
+    static YacTranslationUnit *current();
+    static void setCurrent(YacTranslationUnit *unit);
+private:
+    YacArena m_arena, m_transient_arena;
+    YacSemanticAnalyzer *m_analyzer;
+    llvm::LLVMContext &m_context;
+    YacSourceManager m_sources;
+    YacIdentifierTable m_identifiers;
+    YacTypeContext m_types;
+    YacScope *m_root;
+    std::vector<YacScope *> m_scopes;
+    YacSymbolTable m_symbols;
+    std::ostream *m_diagnostics;
+    unsigned int m_errors;
+};
 
 #endif
\ No newline at end of file
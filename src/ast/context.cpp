@@ -1,81 +1,146 @@
-#include <llvm/IR/PassManager.h>
-#include <llvm/IR/IRPrintingPasses.h>
-#include <llvm/ExecutionEngine/ExecutionEngine.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Constants.h>
 #include <iostream>
 #include "context.h"
 #include "declaration.h"
 #include "expression.h"
 
-YacSemanticAnalyzer::YacSemanticAnalyzer()
-    : m_module(new llvm::Module("main", YacSemanticAnalyzer::context())), m_block(nullptr), m_function(nullptr) {}
+YacSemanticAnalyzer::YacSemanticAnalyzer(YacTypeContext &types)
+    : m_types(types), m_module(new llvm::Module("main", types.context())), m_block(nullptr), m_function(nullptr),
+      m_function_type(nullptr) {}
 
+llvm::Value *YacSemanticAnalyzer::find(YacDeclaration *declaration)
+{
+    auto iter = m_locals.find(declaration);
+    if (iter != m_locals.end())
+        return iter->second;
+    iter = m_values.find(declaration);
+    return iter == m_values.end() ? nullptr : iter->second;
+}
 
-void YacSemanticAnalyzer::print(llvm::raw_ostream &out) {
-    llvm::PassManager<llvm::Module> pm;
-    llvm::AnalysisManager<llvm::Module> am;
-    pm.addPass(llvm::PrintModulePass(out));
-    pm.run(*m_module, am);
+void YacSemanticAnalyzer::setFunction(llvm::Function *function, const YacFunctionType *type)
+{
+    m_function = function;
+    m_function_type = type;
+    m_locals.clear();
+    m_promoted.clear();
+    m_definitions.clear();
+    m_incomplete_phis.clear();
+    m_sealed.clear();
 }
 
-int YacSemanticAnalyzer::execute(llvm::Function *main, int argc, const char **argv) {
-    llvm::ExecutionEngine *engine = llvm::EngineBuilder(std::move(m_module)).create();
-    if (!engine) {
-        std::cerr << "yac: failed to create execution engine" << std::endl;
-        return 1;
+void YacSemanticAnalyzer::ensureBlockTerminated()
+{
+    assert(!m_block || m_function);
+    if (m_block && !m_block->getTerminator()) {
+        if (m_function->getReturnType()->isVoidTy())
+            llvm::ReturnInst::Create(context(), m_block);
+        else
+            llvm::ReturnInst::Create(context(), llvm::UndefValue::get(m_function->getReturnType()), m_block);
     }
-    engine->finalizeObject();
-    auto func = reinterpret_cast<int (*)(int, const char **)>(engine->getPointerToFunction(main));
-    return func(argc, argv);
 }
 
+llvm::Value *YacSemanticAnalyzer::readVariable(YacDeclaration *variable, llvm::BasicBlock *block)
+{
+    auto iter = m_definitions.find(std::make_pair(variable, block));
+    if (iter != m_definitions.end())
+        return iter->second;
+    return readVariableRecursive(variable, block);
+}
+
+static llvm::PHINode *createPhi(llvm::Type *type, unsigned int count, llvm::BasicBlock *block)
+{
+    if (block->empty())
+        return llvm::PHINode::Create(type, count, "", block);
+    return llvm::PHINode::Create(type, count, "", &block->front());
+}
 
-llvm::LLVMContext *YacSemanticAnalyzer::g_context;
+llvm::Value *YacSemanticAnalyzer::readVariableRecursive(YacDeclaration *variable, llvm::BasicBlock *block)
+{
+    auto type = variable->type->llvmType();
+    llvm::Value *value;
+    if (!m_sealed.count(block)) {
+        // more predecessors may come
+        auto phi = createPhi(type, 0, block);
+        m_incomplete_phis[block].push_back(std::make_pair(variable, phi));
+        value = phi;
+    } else if (auto predecessor = block->getSinglePredecessor()) {
+        value = readVariable(variable, predecessor);
+    } else if (llvm::pred_empty(block)) {
+        // read before any assignment
+        value = llvm::UndefValue::get(type);
+    } else {
+        // the phi breaks cycles through loops
+        auto phi = createPhi(type, 2, block);
+        writeVariable(variable, block, phi);
+        value = addPhiOperands(variable, phi);
+    }
+    writeVariable(variable, block, value);
+    return value;
+}
 
-llvm::LLVMContext &YacSemanticAnalyzer::context() {
-    if (g_context)
-        return *g_context;
-    g_context = new llvm::LLVMContext;
-    return *g_context;
+llvm::Value *YacSemanticAnalyzer::addPhiOperands(YacDeclaration *variable, llvm::PHINode *phi)
+{
+    auto block = phi->getParent();
+    for (auto predecessor: llvm::predecessors(block))
+        phi->addIncoming(readVariable(variable, predecessor), predecessor);
+    return tryRemoveTrivialPhi(phi);
 }
 
-llvm::Value *YacSemanticAnalyzer::find(YacDeclaration *declaration)
+// A phi merging only itself and one other value is replaced by that value,
+// which may make the phis using it trivial in turn.
+llvm::Value *YacSemanticAnalyzer::tryRemoveTrivialPhi(llvm::PHINode *phi)
 {
-    auto iter = m_values.find(declaration);
-    return iter == m_values.end() ? nullptr : iter->second;
+    llvm::Value *same = nullptr;
+    for (auto &operand: phi->incoming_values()) {
+        if (operand == same || operand == phi)
+            continue;
+        if (same)
+            return phi;
+        same = operand;
+    }
+    if (!same)
+        same = llvm::UndefValue::get(phi->getType());
+    std::vector<llvm::WeakVH> users;
+    for (auto user: phi->users())
+        if (user != phi && llvm::isa<llvm::PHINode>(user))
+            users.emplace_back(user);
+    phi->replaceAllUsesWith(same);
+    phi->eraseFromParent();
+    for (auto &user: users)
+        if (user)
+            tryRemoveTrivialPhi(llvm::cast<llvm::PHINode>(user));
+    return same;
 }
 
-void YacSemanticAnalyzer::ensureBlockTerminated()
+void YacSemanticAnalyzer::sealBlock(llvm::BasicBlock *block)
 {
-    assert(!m_block || m_function);
-    if (m_block && !m_block->getTerminator()) {
-        if (m_function->getReturnType()->isVoidTy()) {
-            llvm::ReturnInst::Create(YacSemanticAnalyzer::context(), m_block);
-        } else {
-            llvm::Value *variable = new llvm::AllocaInst(m_function->getReturnType(), 0, "", m_block);
-            llvm::Value *value = new llvm::LoadInst(variable, "", m_block);
-            llvm::ReturnInst::Create(YacSemanticAnalyzer::context(), value, m_block);
-        }
+    auto iter = m_incomplete_phis.find(block);
+    if (iter != m_incomplete_phis.end()) {
+        auto phis = std::move(iter->second);
+        m_incomplete_phis.erase(iter);
+        for (auto &phi: phis)
+            addPhiOperands(phi.first, phi.second);
     }
+    m_sealed.insert(block);
 }
 
-YacFunctionDefinition *addEntry(YacDeclaration *main)
+YacFunctionDefinition *addEntry(YacDeclaration *main, YacTranslationUnit &unit)
 {
     assert(main);
-    llvm::LLVMContext &context = YacSemanticAnalyzer::context();
-    llvm::Type *type1 = llvm::Type::getInt32Ty(context),
-            *type2 = llvm::PointerType::getUnqual(llvm::PointerType::getUnqual(llvm::Type::getInt32Ty(context)));
-    std::vector<llvm::Type *> types {type1, type2};
-    auto arg1 = new YacDeclaration(type1), arg2 = new YacDeclaration(type2);
-    auto params = new YacScope;
+    auto &types = unit.types();
+    const YacType *type1 = types.getInt(), *type2 = types.getPointer(types.getPointer(types.getChar()));
+    auto arg1 = unit.make<YacDeclaration>(type1), arg2 = unit.make<YacDeclaration>(type2);
+    auto params = unit.make<YacScope>();
     params->addNode(arg1);
     params->addNode(arg2);
-    auto func = new YacFunctionDefinition(
-            llvm::FunctionType::get(type1, types, false),
-            params, new YacCallExpression(new YacObjectExpression(main), new YacExpressionList{
-                    new YacObjectExpression(arg1),
-                    new YacObjectExpression(arg2)
-            }));
-    root->addNode(func);
+    auto args = unit.make<YacExpressionList>();
+    args->push_back(unit.make<YacObjectExpression>(arg1));
+    args->push_back(unit.make<YacObjectExpression>(arg2));
+    auto func = unit.make<YacFunctionDefinition>(
+            types.getFunction(type1, {type1, type2}, false),
+            params, unit.make<YacCallExpression>(unit.make<YacObjectExpression>(main), args));
+    unit.root()->addNode(func);
     return func;
 }
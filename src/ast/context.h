@@ -5,6 +5,10 @@
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/ValueHandle.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
 #include <llvm/ExecutionEngine/GenericValue.h>
 #include <exception>
 #include <stack>
@@ -14,23 +18,29 @@
 
 class YacSemanticAnalyzer {
 public:
-    YacSemanticAnalyzer();
+    explicit YacSemanticAnalyzer(YacTypeContext &types);
 
-    static llvm::LLVMContext &context();
+    llvm::LLVMContext &context() {
+        return m_module->getContext();
+    }
+    YacTypeContext &types() {
+        return m_types;
+    }
 
     llvm::Module &module() {
         return *m_module;
     }
+    std::unique_ptr<llvm::Module> takeModule() {
+        return std::move(m_module);
+    }
 
     llvm::Value *find(YacDeclaration *declaration);
+    // declarations inside a function are forgotten when the function ends
     void add(YacDeclaration *declaration, llvm::Value *value) {
         assert(value);
-        m_values.insert(std::make_pair(declaration, value));
+        (m_function ? m_locals : m_values).insert(std::make_pair(declaration, value));
     }
 
-    void print(llvm::raw_ostream &out);
-    int execute(llvm::Function *main, int argc, const char **argv);
-
     llvm::BasicBlock *block() {
         return m_block;
     }
@@ -40,22 +50,52 @@ public:
     llvm::Function *function() {
         return m_function;
     }
-    void setFunction(llvm::Function *function) {
-        m_function = function;
+    // the type of the function being generated
+    const YacFunctionType *functionType() {
+        return m_function_type;
     }
+    void setFunction(llvm::Function *function, const YacFunctionType *type = nullptr);
     void ensureBlockTerminated();
 
+    // Scalar locals whose address is never taken live in SSA registers
+    // rather than in allocas. Their values are tracked per basic block and
+    // phis are placed on the fly (Braun et al., "Simple and Efficient
+    // Construction of Static Single Assignment Form"): a block must be sealed
+    // once all its predecessors are known.
+    void promote(YacDeclaration *variable) {
+        m_promoted.insert(variable);
+    }
+    bool isPromoted(YacDeclaration *variable) {
+        return m_promoted.count(variable) != 0;
+    }
+    void writeVariable(YacDeclaration *variable, llvm::BasicBlock *block, llvm::Value *value) {
+        m_definitions[std::make_pair(variable, block)] = value;
+    }
+    llvm::Value *readVariable(YacDeclaration *variable, llvm::BasicBlock *block);
+    void sealBlock(llvm::BasicBlock *block);
+
 private:
-    std::map<YacDeclaration *, llvm::Value *> m_values;
+    llvm::Value *readVariableRecursive(YacDeclaration *variable, llvm::BasicBlock *block);
+    llvm::Value *addPhiOperands(YacDeclaration *variable, llvm::PHINode *phi);
+    llvm::Value *tryRemoveTrivialPhi(llvm::PHINode *phi);
+
+    YacTypeContext &m_types;
+    std::map<YacDeclaration *, llvm::Value *> m_values, m_locals;
     std::unique_ptr<llvm::Module> m_module;
     llvm::BasicBlock *m_block;
     llvm::Function *m_function;
-    static llvm::LLVMContext *g_context;
+    const YacFunctionType *m_function_type;
+
+    llvm::DenseSet<YacDeclaration *> m_promoted;
+    // follow the phis replaced by tryRemoveTrivialPhi()
+    llvm::DenseMap<std::pair<YacDeclaration *, llvm::BasicBlock *>, llvm::WeakTrackingVH> m_definitions;
+    llvm::DenseMap<llvm::BasicBlock *, std::vector<std::pair<YacDeclaration *, llvm::PHINode *>>> m_incomplete_phis;
+    llvm::DenseSet<llvm::BasicBlock *> m_sealed;
 };
 
 
 class YacFunctionDefinition;
 
-YacFunctionDefinition *addEntry(YacDeclaration *main);
+YacFunctionDefinition *addEntry(YacDeclaration *main, YacTranslationUnit &unit);
 
 #endif
\ No newline at end of file
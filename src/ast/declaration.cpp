@@ -6,11 +6,12 @@
 #include "expression.h"
 #include "context.h"
 #include "type.h"
+#include "../trace.h"
 
-YacDeclaratorIdentifier::YacDeclaratorIdentifier(std::string *identifier)
+YacDeclaratorIdentifier::YacDeclaratorIdentifier(const YacIdentifier *identifier)
     : m_identifier(identifier) {}
 
-std::string *YacDeclaratorIdentifier::identifier() {
+const YacIdentifier *YacDeclaratorIdentifier::identifier() {
     return m_identifier;
 }
 
@@ -18,95 +19,197 @@ std::string *YacDeclaratorIdentifier::identifier() {
 YacDeclaratorHasParent::YacDeclaratorHasParent(YacDeclaratorBuilder *parent)
         : parent(parent) {}
 
-llvm::Type *YacDeclaratorHasParent::type(llvm::Type *specifier) {
+const YacType *YacDeclaratorHasParent::type(const YacType *specifier) {
     return parent->type(specifier);
 }
 
-std::string *YacDeclaratorHasParent::identifier() {
+const YacIdentifier *YacDeclaratorHasParent::identifier() {
     return parent->identifier();
 }
 
 
-YacDeclaratorPointer::YacDeclaratorPointer(YacDeclaratorBuilder *parent)
-    : YacDeclaratorHasParent(parent)  {}
+static unsigned int qualifiersFromSpecifiers(int specifiers)
+{
+    unsigned int qualifiers = 0;
+    if (specifiers & QualifierConst)
+        qualifiers |= YacType::Const;
+    if (specifiers & QualifierVolatile)
+        qualifiers |= YacType::Volatile;
+    return qualifiers;
+}
+
+YacDeclaratorPointer::YacDeclaratorPointer(YacDeclaratorBuilder *parent, int qualifiers)
+    : YacDeclaratorHasParent(parent), m_qualifiers(qualifiers)  {}
 
-llvm::Type *YacDeclaratorPointer::type(llvm::Type *specifier) {
-    return YacDeclaratorHasParent::type(llvm::PointerType::getUnqual(specifier));
+const YacType *YacDeclaratorPointer::type(const YacType *specifier) {
+    auto &types = specifier->context();
+    return YacDeclaratorHasParent::type(types.getQualified(types.getPointer(specifier), qualifiersFromSpecifiers(m_qualifiers)));
 }
 
 
 YacDeclaratorArray::YacDeclaratorArray(YacDeclaratorBuilder *parent, uint64_t num)
     : YacDeclaratorHasParent(parent), m_num(num) {}
 
-llvm::Type *YacDeclaratorArray::type(llvm::Type *specifier) {
-    return YacDeclaratorHasParent::type(llvm::ArrayType::get(specifier, m_num));
+const YacType *YacDeclaratorArray::type(const YacType *specifier) {
+    return YacDeclaratorHasParent::type(specifier->context().getArray(specifier, m_num));
 }
 
 
 YacDeclaratorFunction::YacDeclaratorFunction(YacDeclaratorBuilder *parent, YacDeclarationList *node, bool var_arg)
-        : YacDeclaratorHasParent(parent), m_node(node), m_var_arg(var_arg) {}
+        : YacDeclaratorHasParent(parent), m_node(node), m_var_arg(var_arg) {
+    // `(void)' declares no parameter
+    if (m_node && m_node->children.size() == 1 && !m_var_arg) {
+        auto param = m_node->children.front();
+        if (param->type->isVoid() && !param->type->qualifiers() && !param->identifier)
+            m_node->children.clear();
+    }
+}
 
-llvm::Type *YacDeclaratorFunction::type(llvm::Type *specifier)
+const YacType *YacDeclaratorFunction::type(const YacType *specifier)
 {
-    std::vector<llvm::Type *> params;
+    std::vector<const YacType *> params;
     if (m_node)
         for (auto node: m_node->children)
-            params.push_back(node->type);
-    return YacDeclaratorHasParent::type(llvm::FunctionType::get(specifier, params, m_var_arg));
+            params.push_back(node->type->unqualified());
+    return YacDeclaratorHasParent::type(specifier->context().getFunction(specifier, params, m_var_arg));
 }
 
 
-YacDeclaration::YacDeclaration(llvm::Type *type, std::string *identifier, int specifier)
+int addSpecifier(int specifiers, int specifier)
+{
+    if (specifier == TypeLong && (specifiers & TypeLong))
+        return (specifiers & ~TypeLong) | TypeLongLong;
+    if ((specifiers & specifier) || (specifier == TypeLong && (specifiers & TypeLongLong))) {
+        diagnostics() << "yac: " << YacSyntaxError("duplicate declaration specifier") << std::endl;
+        return specifiers;
+    }
+    if ((specifier & StorageClassSpecifiers) && (specifiers & StorageClassSpecifiers)) {
+        diagnostics() << "yac: " << YacSyntaxError("multiple storage classes in declaration specifiers") << std::endl;
+        return specifiers;
+    }
+    return specifiers | specifier;
+}
+
+const YacType *typeFromSpecifiers(YacTypeContext &types, int specifiers)
+{
+    int sign = specifiers & (TypeSigned | TypeUnsigned);
+    int base = specifiers & TypeSpecifiers & ~(TypeSigned | TypeUnsigned);
+    const YacType *type = nullptr;
+    switch (base) {
+        case TypeVoid:
+            type = types.getVoid();
+            break;
+        case TypeFloat:
+            type = types.getFloating(false);
+            break;
+        case TypeDouble:
+        case TypeLong | TypeDouble:  // long double is double
+            type = types.getFloating(true);
+            break;
+        case TypeChar:
+            type = types.getInteger(YacIntegerType::Char, sign != TypeUnsigned);
+            break;
+        case TypeShort:
+        case TypeShort | TypeInt:
+            type = types.getInteger(YacIntegerType::Short, sign != TypeUnsigned);
+            break;
+        case 0:  // implicit int
+        case TypeInt:
+            type = types.getInteger(YacIntegerType::Int, sign != TypeUnsigned);
+            break;
+        case TypeLong:
+        case TypeLong | TypeInt:
+            type = types.getInteger(YacIntegerType::Long, sign != TypeUnsigned);
+            break;
+        case TypeLongLong:
+        case TypeLongLong | TypeInt:
+            type = types.getInteger(YacIntegerType::LongLong, sign != TypeUnsigned);
+            break;
+        default:
+            break;
+    }
+    if (!type || sign == (TypeSigned | TypeUnsigned) || (sign && !type->isInteger())) {
+        diagnostics() << "yac: " << YacSyntaxError("invalid combination of type specifiers") << std::endl;
+        type = types.getInt();
+    }
+    return types.getQualified(type, qualifiersFromSpecifiers(specifiers));
+}
+
+
+YacDeclaration::YacDeclaration(const YacType *type, const YacIdentifier *identifier, int specifier)
     : YacSyntaxTreeNode(), type(type), identifier(identifier), specifier(specifier) {
     assert(type);
 }
 
 llvm::Value *YacDeclaration::generate(YacSemanticAnalyzer &context)
 {
+    if (isType())
+        return nullptr;
     llvm::Value *var;
-    if (type->isFunctionTy()) {
-        auto function_type = llvm::cast<llvm::FunctionType>(type);
+    if (type->isFunction()) {
+        auto function_type = llvm::cast<YacFunctionType>(type);
         if (!isValidFunctionType(function_type))
             return nullptr;
-        var = llvm::Function::Create(function_type, llvm::GlobalValue::ExternalLinkage,
-                                     *identifier, &context.module());
+        var = llvm::Function::Create(function_type->llvmFunctionType(), linkage(), identifier->str(), &context.module());
     } else {
         if (!isValidVariableType(type))
             return nullptr;
         auto block = context.block();
-        if (!block) {
-            llvm::Constant *init = llvm::Constant::getNullValue(type);
-            var = new llvm::GlobalVariable(context.module(), type, false, llvm::GlobalVariable::CommonLinkage,
-                                           init, *identifier);
-        } else
-            var = new llvm::AllocaInst(type, 0, "", block);
+        if (!block || (specifier & (Static | Extern))) {
+            // objects of static storage duration
+            llvm::Constant *init = nullptr;
+            auto linkage = this->linkage();
+            if (!(specifier & Extern)) {
+                init = llvm::Constant::getNullValue(type->llvmType());
+                if (!(specifier & Static))
+                    linkage = llvm::GlobalVariable::CommonLinkage;
+            }
+            var = new llvm::GlobalVariable(context.module(), type->llvmType(), false, linkage, init, identifier->str());
+        } else if (isPromotable()) {
+            // no storage, the value is tracked by the analyzer
+            context.promote(this);
+            context.writeVariable(this, block, llvm::UndefValue::get(type->llvmType()));
+            return nullptr;
+        } else {
+            // allocas in the entry block are cheap to promote by mem2reg
+            auto &entry = context.function()->getEntryBlock();
+            if (entry.empty())
+                var = new llvm::AllocaInst(type->llvmType(), 0, "", &entry);
+            else
+                var = new llvm::AllocaInst(type->llvmType(), 0, "", &entry.front());
+        }
     }
     context.add(this, var);
     return var;
 }
 
 
-YacFunctionDefinition::YacFunctionDefinition(llvm::FunctionType *type, YacScope *params, YacSyntaxTreeNode *body, std::string *identifier, int specifier)
+YacFunctionDefinition::YacFunctionDefinition(const YacFunctionType *type, YacScope *params, YacSyntaxTreeNode *body, const YacIdentifier *identifier, int specifier)
         : YacDeclaration(type, identifier, specifier), params(params), body(body) {}
 
 llvm::Value *YacFunctionDefinition::generate(YacSemanticAnalyzer &context)
 {
-    auto type = llvm::cast<llvm::FunctionType>(this->type);
+    auto type = llvm::cast<YacFunctionType>(this->type);
     if (!isValidFunctionType(type))
         return nullptr;
     assert(!context.function() && !context.block());
-    auto function = llvm::Function::Create(type, llvm::GlobalValue::ExternalLinkage, identifier ? *identifier : "",
+    YacTimeScope scope("Generate function", identifier ? identifier->str() : llvm::StringRef());
+    auto function = llvm::Function::Create(type->llvmFunctionType(), linkage(), identifier ? identifier->str() : "",
                                       &context.module());
     context.add(this, function);
-    auto block = llvm::BasicBlock::Create(YacSemanticAnalyzer::context(), "", function);
-    context.setFunction(function);
+    auto block = llvm::BasicBlock::Create(context.context(), "", function);
+    context.setFunction(function, type);
     context.setBlock(block);
+    context.sealBlock(block);
     auto arg_values = function->arg_begin();
     if (params) {
-        for (auto param: params->children) {
+        for (auto node: params->children) {
+            auto param = static_cast<YacDeclaration *>(node);
             auto variable = param->generate(context);
-            if (variable)
-                new llvm::StoreInst(arg_values, variable, block);
+            if (context.isPromoted(param))
+                context.writeVariable(param, block, arg_values);
+            else if (variable)
+                new llvm::StoreInst(arg_values, variable, param->type->isVolatile(), block);
             ++arg_values;
         }
     }
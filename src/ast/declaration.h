@@ -1,8 +1,7 @@
 #ifndef DECLARATION_H_INCLUDE
 #define DECLARATION_H_INCLUDE
 
-#include <llvm/IR/Type.h>
-#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/GlobalValue.h>
 #include <string>
 #include <vector>
 #include <map>
@@ -13,39 +12,42 @@
 class YacDeclaratorBuilder {
 public:
     virtual ~YacDeclaratorBuilder() = default;
-    virtual llvm::Type *type(llvm::Type *specifier) {
+    virtual const YacType *type(const YacType *specifier) {
         return specifier;
     }
-    virtual std::string *identifier() = 0;
+    virtual const YacIdentifier *identifier() = 0;
 };
 
 class YacDeclaratorIdentifier: public YacDeclaratorBuilder {
 public:
-    explicit YacDeclaratorIdentifier(std::string *identifier = nullptr);
-    std::string *identifier() override;
+    explicit YacDeclaratorIdentifier(const YacIdentifier *identifier = nullptr);
+    const YacIdentifier *identifier() override;
 private:
-    std::string *m_identifier;
+    const YacIdentifier *m_identifier;
 };
 
 class YacDeclaratorHasParent: public YacDeclaratorBuilder {
 public:
     explicit YacDeclaratorHasParent(YacDeclaratorBuilder *parent);
-    llvm::Type *type(llvm::Type *specifier) override;
-    std::string *identifier() override;
+    const YacType *type(const YacType *specifier) override;
+    const YacIdentifier *identifier() override;
 private:
     YacDeclaratorBuilder *parent;
 };
 
 class YacDeclaratorPointer: public YacDeclaratorHasParent {
 public:
-    explicit YacDeclaratorPointer(YacDeclaratorBuilder *parent);
-    llvm::Type *type(llvm::Type *specifier) override;
+    // `qualifiers' are the YacSpecifiers following the `*'
+    explicit YacDeclaratorPointer(YacDeclaratorBuilder *parent, int qualifiers = 0);
+    const YacType *type(const YacType *specifier) override;
+private:
+    int m_qualifiers;
 };
 
 class YacDeclaratorArray: public YacDeclaratorHasParent {
 public:
     YacDeclaratorArray(YacDeclaratorBuilder *parent, uint64_t num);
-    llvm::Type *type(llvm::Type *specifier) override;
+    const YacType *type(const YacType *specifier) override;
 private:
     uint64_t m_num;
 };
@@ -55,7 +57,7 @@ class YacDeclarationList;
 class YacDeclaratorFunction: public YacDeclaratorHasParent {
 public:
     explicit YacDeclaratorFunction(YacDeclaratorBuilder *parent, YacDeclarationList *list = nullptr, bool var_arg = false);
-    llvm::Type *type(llvm::Type *specifier) override;
+    const YacType *type(const YacType *specifier) override;
     YacDeclarationList *node() {
         return m_node;
     }
@@ -72,21 +74,54 @@ enum YacSpecifiers {
     Register = 1 << 3,
     Static   = 1 << 4,
     Extern   = 1 << 5,
+
+    TypeVoid     = 1 << 6,
+    TypeChar     = 1 << 7,
+    TypeShort    = 1 << 8,
+    TypeInt      = 1 << 9,
+    TypeLong     = 1 << 10,
+    TypeLongLong = 1 << 11,
+    TypeFloat    = 1 << 12,
+    TypeDouble   = 1 << 13,
+    TypeSigned   = 1 << 14,
+    TypeUnsigned = 1 << 15,
+
+    QualifierConst    = 1 << 16,
+    QualifierVolatile = 1 << 17,
+
+    StorageClassSpecifiers = Typedef | Auto | Register | Static | Extern,
+    TypeSpecifiers = TypeVoid | TypeChar | TypeShort | TypeInt | TypeLong | TypeLongLong | TypeFloat | TypeDouble
+                     | TypeSigned | TypeUnsigned,
+    TypeQualifiers = QualifierConst | QualifierVolatile,
 };
 
+// merges `specifier' into `specifiers', `long long' is two TypeLong
+int addSpecifier(int specifiers, int specifier);
+// the type named by the type specifiers and qualifiers in `specifiers'
+const YacType *typeFromSpecifiers(YacTypeContext &types, int specifiers);
+
 class YacScope;
 
 class YacDeclaration: public YacSyntaxTreeNode {
 public:
-    llvm::Type *type;
-    std::string *identifier;
+    const YacType *type;
+    const YacIdentifier *identifier;
     int specifier;
+    // set by `&', such an object cannot live in a register
+    bool addressed = false;
 
-    explicit YacDeclaration(llvm::Type *type, std::string *identifier = nullptr, int specifier = 0);
+    explicit YacDeclaration(const YacType *type, const YacIdentifier *identifier = nullptr, int specifier = 0);
     llvm::Value* generate(YacSemanticAnalyzer &context) override;
     bool isType() {
         return (specifier & Typedef) != 0;
     }
+    // automatic scalars kept in SSA registers, see YacSemanticAnalyzer::promote()
+    bool isPromotable() {
+        return !(specifier & (Static | Extern)) && !addressed && type->isScalar() && !type->isVolatile();
+    }
+    llvm::GlobalValue::LinkageTypes linkage() {
+        return (specifier & Static) ? llvm::GlobalValue::InternalLinkage : llvm::GlobalValue::ExternalLinkage;
+    }
 };
 
 
@@ -111,8 +146,8 @@ public:
     YacScope *params;
     YacSyntaxTreeNode *body;
 
-    explicit YacFunctionDefinition(llvm::FunctionType *type, YacScope *params = nullptr, YacSyntaxTreeNode *body = nullptr,
-                                   std::string *identifier = nullptr, int specifier = 0);
+    explicit YacFunctionDefinition(const YacFunctionType *type, YacScope *params = nullptr, YacSyntaxTreeNode *body = nullptr,
+                                   const YacIdentifier *identifier = nullptr, int specifier = 0);
     llvm::Value* generate(YacSemanticAnalyzer &context) override;
 };
 
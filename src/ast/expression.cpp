@@ -7,18 +7,136 @@
 #include "declaration.h"
 #include "expression.h"
 #include "type.h"
+#include "../syntax/syntax.h"
 
-YacConstantExpression::YacConstantExpression(llvm::Value *value)
-    : value(value) {}
+static void invalidOperands(const YacType *left, const YacType *right, YacSyntaxTreeNode *node) {
+    diagnostics() << "yac: " << YacSemanticError("invalid operands to binary expression (`" + left->name() + "' and `"
+                                                 + right->name() + "')", node) << std::endl;
+}
+
+// the instruction computing `left token right' in `type' for the arithmetic,
+// bitwise and shift operators
+static llvm::Instruction::BinaryOps arithmeticOpcode(const YacType *type, int token) {
+    bool is_floating = type->isFloating(), is_signed = type->isSigned();
+    switch (token) {
+        case '*':      return is_floating ? llvm::Instruction::FMul : llvm::Instruction::Mul;
+        case '/':      return is_floating ? llvm::Instruction::FDiv : is_signed ? llvm::Instruction::SDiv : llvm::Instruction::UDiv;
+        case '%':      return is_signed ? llvm::Instruction::SRem : llvm::Instruction::URem;
+        case '+':      return is_floating ? llvm::Instruction::FAdd : llvm::Instruction::Add;
+        case '-':      return is_floating ? llvm::Instruction::FSub : llvm::Instruction::Sub;
+        case '&':      return llvm::Instruction::And;
+        case '^':      return llvm::Instruction::Xor;
+        case '|':      return llvm::Instruction::Or;
+        case LEFT_OP:  return llvm::Instruction::Shl;
+        case RIGHT_OP: return is_signed ? llvm::Instruction::AShr : llvm::Instruction::LShr;
+        default:       llvm_unreachable("not an arithmetic operator");
+    }
+}
+
+// the predicate comparing two operands of type `type', pointers compare unsigned
+static llvm::CmpInst::Predicate comparePredicate(const YacType *type, int token) {
+    if (type->isFloating()) {
+        switch (token) {
+            case '<':   return llvm::CmpInst::FCMP_OLT;
+            case '>':   return llvm::CmpInst::FCMP_OGT;
+            case LE_OP: return llvm::CmpInst::FCMP_OLE;
+            case GE_OP: return llvm::CmpInst::FCMP_OGE;
+            case EQ_OP: return llvm::CmpInst::FCMP_OEQ;
+            default:    return llvm::CmpInst::FCMP_UNE;
+        }
+    }
+    bool is_signed = type->isInteger() && type->isSigned();
+    switch (token) {
+        case '<':   return is_signed ? llvm::CmpInst::ICMP_SLT : llvm::CmpInst::ICMP_ULT;
+        case '>':   return is_signed ? llvm::CmpInst::ICMP_SGT : llvm::CmpInst::ICMP_UGT;
+        case LE_OP: return is_signed ? llvm::CmpInst::ICMP_SLE : llvm::CmpInst::ICMP_ULE;
+        case GE_OP: return is_signed ? llvm::CmpInst::ICMP_SGE : llvm::CmpInst::ICMP_UGE;
+        case EQ_OP: return llvm::CmpInst::ICMP_EQ;
+        default:    return llvm::CmpInst::ICMP_NE;
+    }
+}
+
+static bool isArithmeticConstant(llvm::Constant *value) {
+    return llvm::isa<llvm::ConstantInt>(value) || llvm::isa<llvm::ConstantFP>(value);
+}
+
+// whether `value' compares equal to 0 at run time, -0.0 included
+static bool isZeroConstant(llvm::Constant *value) {
+    if (auto floating = llvm::dyn_cast<llvm::ConstantFP>(value))
+        return floating->isZero();
+    return value->isNullValue();
+}
+
+// value of `left token right' of type `type', nullptr if it is not a constant
+// expression or must not be computed at compile time (e.g. division by zero)
+static llvm::Constant *foldBinaryExpression(llvm::Constant *left, const YacType *left_type, llvm::Constant *right,
+                                            const YacType *right_type, int token, const YacType *type) {
+    auto int_type = type->context().getInt()->llvmType();
+    if (token == AND_OP || token == OR_OP) {
+        // the right operand is not evaluated when the left one decides
+        if (left && isZeroConstant(left) == (token == AND_OP))
+            return llvm::ConstantInt::get(int_type, token == OR_OP);
+        if (!left || !right)
+            return nullptr;
+        return llvm::ConstantInt::get(int_type, !isZeroConstant(right));
+    }
+    if (!left || !right || !isArithmeticConstant(left) || !isArithmeticConstant(right) || !type->isArithmetic())
+        return nullptr;
+    switch (token) {
+        case '<':
+        case '>':
+        case LE_OP:
+        case GE_OP:
+        case EQ_OP:
+        case NE_OP: {
+            auto common_type = usualArithmeticConversions(left_type, right_type);
+            auto result = llvm::ConstantExpr::getCompare(comparePredicate(common_type, token),
+                                                         castConstantToType(left, left_type, common_type),
+                                                         castConstantToType(right, right_type, common_type));
+            return llvm::ConstantExpr::getZExt(result, int_type);
+        }
+        case LEFT_OP:
+        case RIGHT_OP: {
+            // shifting by a negative amount or by the width is undefined
+            auto amount = llvm::cast<llvm::ConstantInt>(right);
+            if ((right_type->isSigned() && amount->isNegative())
+                    || amount->getValue().uge(llvm::cast<YacIntegerType>(type)->bits()))
+                return nullptr;
+            break;
+        }
+        case '/':
+        case '%': {
+            if (type->isFloating())
+                break;
+            auto divisor = llvm::dyn_cast<llvm::ConstantInt>(castConstantToType(right, right_type, type));
+            auto dividend = llvm::dyn_cast<llvm::ConstantInt>(castConstantToType(left, left_type, type));
+            if (!divisor || !dividend || divisor->isZero()
+                    || (type->isSigned() && divisor->isMinusOne() && dividend->isMinValue(true)))
+                return nullptr;
+            break;
+        }
+        default:
+            break;
+    }
+    return llvm::ConstantExpr::get(arithmeticOpcode(type, token), castConstantToType(left, left_type, type),
+                                   castConstantToType(right, right_type, type));
+}
+
+YacConstantExpression::YacConstantExpression(llvm::Constant *value, const YacType *type)
+    : value(value) {
+    this->type = type;
+    if (!isString())
+        constant = value;
+}
 
 llvm::Value *YacConstantExpression::generateRvalue(YacSemanticAnalyzer &context) {
     if (isString()) {
         // String literature
         auto variable = new llvm::GlobalVariable(context.module(), value->getType(), true, llvm::GlobalVariable::PrivateLinkage,
-                                                 llvm::cast<llvm::Constant>(value), "");
+                                                 value, "");
         return llvm::GetElementPtrInst::CreateInBounds(variable, {
-                llvm::ConstantInt::get(llvm::Type::getInt32Ty(YacSemanticAnalyzer::context()), 0),
-                llvm::ConstantInt::get(llvm::Type::getInt32Ty(YacSemanticAnalyzer::context()), 0)
+                llvm::ConstantInt::get(llvm::Type::getInt32Ty(context.context()), 0),
+                llvm::ConstantInt::get(llvm::Type::getInt32Ty(context.context()), 0)
         }, "", context.block());
     }
     return value;
@@ -26,149 +144,586 @@ llvm::Value *YacConstantExpression::generateRvalue(YacSemanticAnalyzer &context)
 
 
 llvm::Value *YacLvalueExpression::generateRvalue(YacSemanticAnalyzer &context) {
-    return castLvalueToRvalue(generateLvalue(context), context);
+    return castLvalueToRvalue(generateLvalue(context), type, context);
 }
 
 
 YacObjectExpression::YacObjectExpression(YacDeclaration *declaration)
-    : declaration(declaration) { assert(declaration); }
+    : declaration(declaration) {
+    assert(declaration);
+    type = declaration->type;
+}
 
 llvm::Value *YacObjectExpression::generateLvalue(YacSemanticAnalyzer &context) {
+    if (context.isPromoted(declaration))
+        return nullptr;
     auto variable = context.find(declaration);
     if (!variable)  // should not happen
-        std::cerr << "yac: " << YacSemanticError("object does not exist", this) << std::endl;
+        diagnostics() << "yac: " << YacSemanticError("object does not exist", this) << std::endl;
     return variable;
 }
 
+llvm::Value *YacObjectExpression::generateRvalue(YacSemanticAnalyzer &context) {
+    if (context.isPromoted(declaration))
+        return context.readVariable(declaration, context.block());
+    return YacLvalueExpression::generateRvalue(context);
+}
+
+// the promoted variable designated by `expression', if any
+static YacDeclaration *promotedVariable(YacExpression *expression, YacSemanticAnalyzer &context) {
+    auto object = dynamic_cast<YacObjectExpression *>(expression);
+    if (object && context.isPromoted(object->declaration))
+        return object->declaration;
+    return nullptr;
+}
+
 YacCallExpression::YacCallExpression(YacExpression *func, YacExpressionList *args)
-    : func(func), args(args) {}
+    : func(func), args(args) {
+    auto function_type = getFunc();
+    if (function_type)
+        type = function_type->result();
+}
 
-llvm::FunctionType *YacCallExpression::getFunc(llvm::Value *function, YacSemanticAnalyzer &context) {
-    if (!function->getType()->isPointerTy()) {
-        std::cerr << "called object type is not a function or function pointer" << std::endl;
+const YacFunctionType *YacCallExpression::getFunc() {
+    if (!func->type)
         return nullptr;
-    }
-    auto value_type = llvm::cast<llvm::PointerType>(function->getType())->getElementType();
-    if (!value_type->isFunctionTy()) {
-        std::cerr << "called object type is not a function or function pointer" << std::endl;
+    auto pointer_type = decay(func->type);
+    if (!pointer_type->isPointer() || !llvm::cast<YacPointerType>(pointer_type)->pointee()->isFunction())
         return nullptr;
-    }
-    return llvm::cast<llvm::FunctionType>(value_type);
+    return llvm::cast<YacFunctionType>(llvm::cast<YacPointerType>(pointer_type)->pointee());
 }
 
-llvm::Value *YacCallExpression::doGenerate(llvm::Value *function, llvm::FunctionType *function_type, YacSemanticAnalyzer &context) {
+llvm::Value *YacCallExpression::doGenerate(llvm::Value *function, const YacFunctionType *function_type, YacSemanticAnalyzer &context) {
     std::vector<llvm::Value *> arguments;
-    if (function_type->isVarArg()) {
-        // at least one fix
-        if (args == nullptr || args->size() < function_type->getNumParams()) {
-            std::cerr << "wrong number of arguments" << std::endl;
+    auto params = function_type->params();
+    size_t count = args ? args->size() : 0;
+    if (function_type->isVarArg() ? count < params.size() : count != params.size()) {
+        diagnostics() << "wrong number of arguments" << std::endl;
+        return nullptr;
+    }
+    auto iter = params.begin();
+    for (size_t i = 0; i < count; ++i) {
+        auto arg = (*args)[i];
+        auto value = arg->generateRvalue(context);
+        if (!value || !arg->type)
             return nullptr;
+        auto arg_type = decay(arg->type);
+        if (iter == params.end()) {
+            arguments.push_back(castValueToType(value, arg_type, defaultArgumentPromotion(arg_type), context));
+            continue;
         }
-        auto params = function_type->params();
-        auto iter = params.begin();
-        for (auto arg: *args) {
-            auto value = arg->generateRvalue(context);
-            if (!value)
-                return nullptr;
-            if (iter != params.end())
-                arguments.push_back(castValueToType(value, *iter++, context));
-            else
-                arguments.push_back(value);
-        }
-    } else {
-        if ((args == nullptr && function_type->getNumParams() != 0) ||
-                (args != nullptr && args->size() != function_type->getNumParams())) {
-            std::cerr << "wrong number of arguments" << std::endl;
+        auto param_type = *iter++;
+        if (!isImplicitlyConvertible(arg_type, value, param_type)) {
+            diagnostics() << "yac: " << YacSemanticError("passing `" + arg_type->name() + "' to parameter of incompatible type `"
+                                                         + param_type->name() + '\'', arg) << std::endl;
             return nullptr;
         }
-        auto params = function_type->params();
-        auto iter = params.begin();
-        if (args)
-            for (auto arg: *args) {
-                auto value = arg->generateRvalue(context);
-                if (!value)
-                    return nullptr;
-                arguments.push_back(castValueToType(value, *iter++, context));
-            }
+        arguments.push_back(castValueToType(value, arg_type, param_type, context));
     }
     return llvm::CallInst::Create(function, arguments, "", context.block());
 }
 
 llvm::Value *YacCallExpression::generate(YacSemanticAnalyzer &context) {
+    auto function_type = getFunc();
+    if (!function_type) {
+        diagnostics() << "called object type is not a function or function pointer" << std::endl;
+        return nullptr;
+    }
     auto function = func->generateRvalue(context);
     if (!function)
         return nullptr;
-    auto function_type = getFunc(function, context);
-    if (!function_type)
-        return nullptr;
     return doGenerate(function, function_type, context);
 }
 
 llvm::Value *YacCallExpression::generateRvalue(YacSemanticAnalyzer &context) {
+    auto function_type = getFunc();
+    if (!function_type) {
+        diagnostics() << "called object type is not a function or function pointer" << std::endl;
+        return nullptr;
+    }
+    if (function_type->result()->isVoid()) {
+        diagnostics() << "access void value" << std::endl;
+        return nullptr;
+    }
     auto function = func->generateRvalue(context);
     if (!function)
         return nullptr;
-    auto function_type = getFunc(function, context);
-    if (!function_type)
+    return doGenerate(function, function_type, context);
+}
+
+YacUnaryExpression::YacUnaryExpression(YacExpression *operand, int token)
+        : operand(operand), token(token) {
+    if (!operand->type)
+        return;
+    auto operand_type = decay(operand->type);
+    bool valid = token == '!' ? operand_type->isScalar()
+                              : token == '~' ? operand_type->isInteger() : operand_type->isArithmetic();
+    if (!valid) {
+        diagnostics() << "yac: " << YacSemanticError("invalid argument type `" + operand_type->name()
+                                                     + "\' to unary expression", this) << std::endl;
+        return;
+    }
+    type = token == '!' ? operand_type->context().getInt() : integerPromotion(operand_type);
+    if (!operand->constant || (token != '!' && !isArithmeticConstant(operand->constant)))
+        return;
+    auto value = castConstantToType(operand->constant, operand_type, type);
+    switch (token) {
+        case '!':
+            constant = llvm::ConstantInt::get(type->llvmType(), isZeroConstant(operand->constant));
+            break;
+        case '-':
+            constant = type->isFloating() ? llvm::ConstantExpr::getFNeg(value) : llvm::ConstantExpr::getNeg(value);
+            break;
+        case '~':
+            constant = llvm::ConstantExpr::getNot(value);
+            break;
+        default:
+            constant = value;
+            break;
+    }
+}
+
+llvm::Value *YacUnaryExpression::generateRvalue(YacSemanticAnalyzer &context)
+{
+    if (!type)
         return nullptr;
-    if (function_type->getReturnType()->isVoidTy()) {
-        std::cerr << "access void value" << std::endl;
+    if (constant)
+        return constant;
+    auto value = operand->generateRvalue(context);
+    if (!value)
         return nullptr;
+    auto operand_type = decay(operand->type);
+    if (token == '!') {
+        auto zero = llvm::Constant::getNullValue(value->getType());
+        llvm::Value *condition;
+        if (operand_type->isFloating())
+            condition = new llvm::FCmpInst(*context.block(), llvm::CmpInst::FCMP_OEQ, value, zero);
+        else
+            condition = new llvm::ICmpInst(*context.block(), llvm::CmpInst::ICMP_EQ, value, zero);
+        return new llvm::ZExtInst(condition, type->llvmType(), "", context.block());
     }
-    return doGenerate(function, function_type, context);
+    value = castValueToType(value, operand_type, type, context);
+    if (token == '-') {
+        if (type->isFloating())
+            return llvm::BinaryOperator::CreateFSub(llvm::ConstantFP::getNegativeZero(type->llvmType()), value, "",
+                                                    context.block());
+        return llvm::BinaryOperator::CreateNeg(value, "", context.block());
+    }
+    if (token == '~')
+        return llvm::BinaryOperator::CreateNot(value, "", context.block());
+    return value;
+}
+
+YacAddressExpression::YacAddressExpression(YacExpression *operand)
+        : operand(operand) {
+    if (!operand->type)
+        return;
+    if (auto object = dynamic_cast<YacObjectExpression *>(operand)) {
+        if (object->declaration->specifier & Register) {
+            diagnostics() << "yac: " << YacSemanticError("address of register variable requested", this) << std::endl;
+            return;
+        }
+        object->declaration->addressed = true;
+    } else if (!dynamic_cast<YacIndirectionExpression *>(operand)) {
+        diagnostics() << "yac: " << YacSemanticError("cannot take the address of an rvalue", this) << std::endl;
+        return;
+    }
+    type = operand->type->context().getPointer(operand->type);
+}
+
+llvm::Value *YacAddressExpression::generateRvalue(YacSemanticAnalyzer &context)
+{
+    if (!type)
+        return nullptr;
+    return operand->generateLvalue(context);
+}
+
+YacIndirectionExpression::YacIndirectionExpression(YacExpression *operand)
+        : operand(operand) {
+    if (!operand->type)
+        return;
+    auto operand_type = decay(operand->type);
+    if (!operand_type->isPointer()) {
+        diagnostics() << "yac: " << YacSemanticError("indirection requires pointer operand (`" + operand_type->name()
+                                                     + "' invalid)", this) << std::endl;
+        return;
+    }
+    type = llvm::cast<YacPointerType>(operand_type)->pointee();
+}
+
+llvm::Value *YacIndirectionExpression::generateLvalue(YacSemanticAnalyzer &context)
+{
+    if (!type)
+        return nullptr;
+    // the pointer is the address of the object
+    return operand->generateRvalue(context);
+}
+
+YacCastExpression::YacCastExpression(const YacType *type, YacExpression *operand)
+        : operand(operand) {
+    if (!operand->type)
+        return;
+    auto operand_type = decay(operand->type);
+    if (!isExplicitlyConvertible(operand_type, type)) {
+        diagnostics() << "yac: " << YacSemanticError("cannot cast `" + operand_type->name() + "\' to `"
+                                                     + type->name() + '\'', this) << std::endl;
+        return;
+    }
+    this->type = type->unqualified();
+    if (operand->constant && !this->type->isVoid())
+        constant = castConstantToType(operand->constant, operand_type, this->type);
+}
+
+llvm::Value *YacCastExpression::generate(YacSemanticAnalyzer &context)
+{
+    if (type && type->isVoid())
+        return operand->generate(context);
+    return generateRvalue(context);
+}
+
+llvm::Value *YacCastExpression::generateRvalue(YacSemanticAnalyzer &context)
+{
+    if (!type)
+        return nullptr;
+    if (type->isVoid()) {
+        diagnostics() << "access void value" << std::endl;
+        return nullptr;
+    }
+    if (constant)
+        return constant;
+    auto value = operand->generateRvalue(context);
+    if (!value)
+        return nullptr;
+    return castValueToType(value, decay(operand->type), type, context);
 }
 
 YacBinaryExpression::YacBinaryExpression(YacExpression *left, YacExpression *right, int token)
-        : left(left), right(right), token(token) {}
+        : left(left), right(right), token(token) {
+    if (!left->type || !right->type)
+        return;
+    type = binaryExpressionCheck(decay(left->type), decay(right->type), token, left->constant, right->constant);
+    if (!type)
+        invalidOperands(decay(left->type), decay(right->type), this);
+    else
+        constant = foldBinaryExpression(left->constant, decay(left->type), right->constant, decay(right->type), token, type);
+}
 
 llvm::Value *YacBinaryExpression::generateRvalue(YacSemanticAnalyzer &context)
 {
+    if (!type)
+        return nullptr;
+    if (constant)
+        return constant;
+    if (token == AND_OP || token == OR_OP)
+        return generateLogical(context);
     auto left_value = left->generateRvalue(context);
     auto right_value = right->generateRvalue(context);
-    return binaryExpression(left_value, right_value, token, context);
+    if (!left_value || !right_value)
+        return nullptr;
+    return binaryExpression(left_value, decay(left->type), right_value, decay(right->type), token, context);
+}
+
+// the right operand is only evaluated when the left one does not decide
+llvm::Value *YacBinaryExpression::generateLogical(YacSemanticAnalyzer &context)
+{
+    auto left_value = left->generateRvalue(context);
+    if (!left_value)
+        return nullptr;
+    auto left_condition = castValueToCondition(left_value, decay(left->type), context);
+    auto left_block = context.block();
+    auto right_block = llvm::BasicBlock::Create(context.context(), "", context.function());
+    auto end_block = llvm::BasicBlock::Create(context.context(), "", context.function());
+    if (token == AND_OP)
+        llvm::BranchInst::Create(right_block, end_block, left_condition, left_block);
+    else
+        llvm::BranchInst::Create(end_block, right_block, left_condition, left_block);
+    context.sealBlock(right_block);
+    context.setBlock(right_block);
+    auto right_value = right->generateRvalue(context);
+    llvm::Value *right_condition = nullptr;
+    if (right_value)
+        right_condition = castValueToCondition(right_value, decay(right->type), context);
+    auto right_end_block = context.block();
+    llvm::BranchInst::Create(end_block, right_end_block);
+    context.sealBlock(end_block);
+    context.setBlock(end_block);
+    if (!right_condition)
+        return nullptr;
+    auto phi = llvm::PHINode::Create(llvm::Type::getInt1Ty(context.context()), 2, "", end_block);
+    phi->addIncoming(llvm::ConstantInt::get(llvm::Type::getInt1Ty(context.context()), token == OR_OP), left_block);
+    phi->addIncoming(right_condition, right_end_block);
+    return new llvm::ZExtInst(phi, type->llvmType(), "", end_block);
+}
+
+// the rvalue of `right' converted to the type of the lvalue `left' for storing
+static llvm::Value *convertForAssignment(YacExpression *left, llvm::Value *value,
+                                         const YacType *value_type, YacSyntaxTreeNode *node,
+                                         YacSemanticAnalyzer &context) {
+    if (left->type->isConst() || left->type->isArray() || left->type->isFunction()) {
+        diagnostics() << "yac: " << YacSemanticError("cannot assign to `" + left->type->name() + '\'', node) << std::endl;
+        return nullptr;
+    }
+    if (!isImplicitlyConvertible(value_type, value, left->type)) {
+        diagnostics() << "yac: " << YacSemanticError("assigning to `" + left->type->name() + "' from incompatible type `"
+                                                     + value_type->name() + '\'', node) << std::endl;
+        return nullptr;
+    }
+    return castValueToType(value, value_type, left->type, context);
 }
 
 YacAssignmentExpression::YacAssignmentExpression(YacExpression *left, YacExpression *right)
-      : left(left), right(right) {}
+      : left(left), right(right) {
+    if (left->type)
+        type = left->type->unqualified();
+}
 
-llvm::Value *YacAssignmentExpression::generateLvalue(YacSemanticAnalyzer &context) {
-    auto left_value = left->generateLvalue(context);
-    if (!left_value)
+llvm::Value *YacAssignmentExpression::generateRvalue(YacSemanticAnalyzer &context) {
+    if (!left->type || !right->type)
         return nullptr;
+    auto variable = promotedVariable(left, context);
+    llvm::Value *left_value = nullptr;
+    if (!variable) {
+        left_value = left->generateLvalue(context);
+        if (!left_value)
+            return nullptr;
+    }
     auto right_value = right->generateRvalue(context);
     if (!right_value)
         return nullptr;
-    new llvm::StoreInst(castValueToType(right_value, llvm::cast<llvm::PointerType>(left_value->getType())->getElementType(), context), left_value, context.block());
-    return left_value;
+    auto value = convertForAssignment(left, right_value, decay(right->type), this, context);
+    if (!value)
+        return nullptr;
+    if (variable)
+        context.writeVariable(variable, context.block(), value);
+    else
+        new llvm::StoreInst(value, left_value, left->type->isVolatile(), context.block());
+    return value;
 }
 
 
 YacCompoundAssignmentExpression::YacCompoundAssignmentExpression(YacExpression *left, YacExpression *right, int token)
-        : left(left), right(right), token(token) {}
+        : left(left), right(right), token(token) {
+    if (!left->type || !right->type)
+        return;
+    if (!binaryExpressionCheck(decay(left->type), decay(right->type), token))
+        invalidOperands(decay(left->type), decay(right->type), this);
+    else
+        type = left->type->unqualified();
+}
 
-llvm::Value *YacCompoundAssignmentExpression::generateLvalue(YacSemanticAnalyzer &context) {
-    auto left_value = left->generateLvalue(context);
-    if (!left_value)
+llvm::Value *YacCompoundAssignmentExpression::generateRvalue(YacSemanticAnalyzer &context) {
+    if (!type)
         return nullptr;
-    auto left_value_rvalue = castLvalueToRvalue(left_value, context);
+    auto variable = promotedVariable(left, context);
+    llvm::Value *left_value = nullptr, *left_value_rvalue;
+    if (variable) {
+        left_value_rvalue = context.readVariable(variable, context.block());
+    } else {
+        left_value = left->generateLvalue(context);
+        if (!left_value)
+            return nullptr;
+        left_value_rvalue = castLvalueToRvalue(left_value, left->type, context);
+    }
+    auto left_type = decay(left->type), right_type = decay(right->type);
     if (!left_value_rvalue)
         return nullptr;
-    auto result = binaryExpression(left_value_rvalue, right->generateRvalue(context), token, context);
+    auto right_value = right->generateRvalue(context);
+    if (!right_value)
+        return nullptr;
+    auto result = binaryExpression(left_value_rvalue, left_type, right_value, right_type, token, context);
     if (!result)
         return nullptr;
-    new llvm::StoreInst(castValueToType(result, llvm::cast<llvm::PointerType>(left_value->getType())->getElementType(), context), left_value, context.block());
-    return left_value;
+    auto value = convertForAssignment(left, result, binaryExpressionCheck(left_type, right_type, token), this, context);
+    if (!value)
+        return nullptr;
+    if (variable)
+        context.writeVariable(variable, context.block(), value);
+    else
+        new llvm::StoreInst(value, left_value, left->type->isVolatile(), context.block());
+    return value;
 }
 
 
-bool binaryExpressionCheck(llvm::Value *left, llvm::Value *right, int token) {
-    if (!left || !right)
-        return false;
-    // TODO
-    // auto left_type = left->getType(), right_type = right->getType();
-    return false;
+// http://en.cppreference.com/w/c/language/operator_arithmetic
+const YacType *binaryExpressionCheck(const YacType *left, const YacType *right, int token,
+                                     llvm::Constant *left_constant, llvm::Constant *right_constant) {
+    assert(left && right);
+    left = left->unqualified();
+    right = right->unqualified();
+    auto &types = left->context();
+    // pointer arithmetic needs the size of the pointed object
+    auto isObjectPointer = [](const YacType *type) {
+        if (!type->isPointer())
+            return false;
+        auto pointee = llvm::cast<YacPointerType>(type)->pointee();
+        return !pointee->isVoid() && !pointee->isFunction();
+    };
+    switch (token) {
+        case '*':
+        case '/':
+            if (left->isArithmetic() && right->isArithmetic())
+                return usualArithmeticConversions(left, right);
+            return nullptr;
+        case '%':
+        case '&':
+        case '^':
+        case '|':
+            if (left->isInteger() && right->isInteger())
+                return usualArithmeticConversions(left, right);
+            return nullptr;
+        case '+':
+            if (left->isArithmetic() && right->isArithmetic())
+                return usualArithmeticConversions(left, right);
+            if (isObjectPointer(left) && right->isInteger())
+                return left;
+            if (left->isInteger() && isObjectPointer(right))
+                return right;
+            return nullptr;
+        case '-':
+            if (left->isArithmetic() && right->isArithmetic())
+                return usualArithmeticConversions(left, right);
+            if (isObjectPointer(left) && right->isInteger())
+                return left;
+            // ptrdiff_t
+            if (isObjectPointer(left) && isObjectPointer(right)
+                    && isCompatible(llvm::cast<YacPointerType>(left)->pointee()->unqualified(),
+                                    llvm::cast<YacPointerType>(right)->pointee()->unqualified()))
+                return types.getLong();
+            return nullptr;
+        case LEFT_OP:
+        case RIGHT_OP:
+            if (left->isInteger() && right->isInteger())
+                return integerPromotion(left);
+            return nullptr;
+        case '<':
+        case '>':
+        case LE_OP:
+        case GE_OP:
+        case EQ_OP:
+        case NE_OP: {
+            if (left->isArithmetic() && right->isArithmetic())
+                return types.getInt();
+            bool equality = token == EQ_OP || token == NE_OP;
+            auto isNullConstant = [](const YacType *type, llvm::Constant *constant) {
+                return constant && isNull(type, constant);
+            };
+            if (left->isPointer() && right->isPointer()) {
+                auto left_pointee = llvm::cast<YacPointerType>(left)->pointee()->unqualified();
+                auto right_pointee = llvm::cast<YacPointerType>(right)->pointee()->unqualified();
+                if (isCompatible(left_pointee, right_pointee))
+                    return types.getInt();
+                // equality also compares an object pointer with `void *' and
+                // any pointer with a null pointer constant
+                if (equality && ((left_pointee->isVoid() && !right_pointee->isFunction())
+                                 || (right_pointee->isVoid() && !left_pointee->isFunction())
+                                 || isNullConstant(left, left_constant) || isNullConstant(right, right_constant)))
+                    return types.getInt();
+                return nullptr;
+            }
+            // comparison with a null pointer constant
+            if (equality && ((left->isPointer() && isNullConstant(right, right_constant))
+                             || (isNullConstant(left, left_constant) && right->isPointer())))
+                return types.getInt();
+            return nullptr;
+        }
+        case AND_OP:
+        case OR_OP:
+            if (left->isScalar() && right->isScalar())
+                return types.getInt();
+            return nullptr;
+        default:
+            return nullptr;
+    }
 }
 
-llvm::Value *binaryExpression(llvm::Value *left, llvm::Value *right, int token, YacSemanticAnalyzer &contex) {
-    return nullptr;
+// `pointer + index' for an object pointer and an integer index
+static llvm::Value *pointerAddition(llvm::Value *pointer, llvm::Value *index, const YacType *index_type, bool negate,
+                                    YacSemanticAnalyzer &context) {
+    auto &types = index_type->context();
+    // indices are sign or zero extended to the width of a pointer
+    index = castValueToType(index, index_type, types.getInteger(YacIntegerType::Long, index_type->isSigned()), context);
+    if (negate)
+        index = llvm::BinaryOperator::CreateNSWNeg(index, "", context.block());
+    return llvm::GetElementPtrInst::CreateInBounds(pointer, {index}, "", context.block());
+}
+
+// `left - right' for two pointers to compatible object types
+static llvm::Value *pointerDifference(llvm::Value *left, const YacType *left_type, llvm::Value *right,
+                                      const YacType *type, YacSemanticAnalyzer &context) {
+    auto block = context.block();
+    auto difference = llvm::BinaryOperator::CreateNSWSub(new llvm::PtrToIntInst(left, type->llvmType(), "", block),
+                                                         new llvm::PtrToIntInst(right, type->llvmType(), "", block),
+                                                         "", block);
+    auto size = sizeOf(llvm::cast<YacPointerType>(left_type)->pointee());
+    if (size == 1)
+        return difference;
+    // both pointers point into the same array, so the division has no remainder
+    return llvm::BinaryOperator::CreateExactSDiv(difference, llvm::ConstantInt::get(type->llvmType(), size), "", block);
+}
+
+llvm::Value *binaryExpression(llvm::Value *left, const YacType *left_type, llvm::Value *right, const YacType *right_type,
+                              int token, YacSemanticAnalyzer &context) {
+    assert(left && right);
+    auto type = binaryExpressionCheck(left_type, right_type, token, llvm::dyn_cast<llvm::Constant>(left),
+                                      llvm::dyn_cast<llvm::Constant>(right));
+    if (!type)
+        return nullptr;
+    left_type = left_type->unqualified();
+    right_type = right_type->unqualified();
+    auto block = context.block();
+    switch (token) {
+        case '<':
+        case '>':
+        case LE_OP:
+        case GE_OP:
+        case EQ_OP:
+        case NE_OP: {
+            llvm::Value *result;
+            if (left_type->isArithmetic() && right_type->isArithmetic()) {
+                auto common_type = usualArithmeticConversions(left_type, right_type);
+                left = castValueToType(left, left_type, common_type, context);
+                right = castValueToType(right, right_type, common_type, context);
+                auto predicate = comparePredicate(common_type, token);
+                if (common_type->isFloating())
+                    result = new llvm::FCmpInst(*block, predicate, left, right);
+                else
+                    result = new llvm::ICmpInst(*block, predicate, left, right);
+            } else {
+                // a pointer and another pointer or a null pointer constant
+                auto pointer_type = left_type->isPointer() ? left_type : right_type;
+                left = castValueToType(left, left_type, pointer_type, context);
+                right = castValueToType(right, right_type, pointer_type, context);
+                result = new llvm::ICmpInst(*block, comparePredicate(pointer_type, token), left, right);
+            }
+            return new llvm::ZExtInst(result, type->llvmType(), "", block);
+        }
+        case '+':
+            if (left_type->isPointer())
+                return pointerAddition(left, right, right_type, false, context);
+            if (right_type->isPointer())
+                return pointerAddition(right, left, left_type, false, context);
+            break;
+        case '-':
+            if (left_type->isPointer() && right_type->isPointer())
+                return pointerDifference(left, left_type, right, type, context);
+            if (left_type->isPointer())
+                return pointerAddition(left, right, right_type, true, context);
+            break;
+        case AND_OP:
+        case OR_OP:
+            llvm_unreachable("logical operators are generated by YacBinaryExpression");
+        default:
+            break;
+    }
+    // both operands, the shift amount too, are computed in the type of the result
+    left = castValueToType(left, left_type, type, context);
+    right = castValueToType(right, right_type, type, context);
+    auto opcode = arithmeticOpcode(type, token);
+    auto result = llvm::BinaryOperator::Create(opcode, left, right, "", block);
+    // signed overflow is undefined
+    if (type->isInteger() && type->isSigned()
+            && (opcode == llvm::Instruction::Add || opcode == llvm::Instruction::Sub
+                || opcode == llvm::Instruction::Mul || opcode == llvm::Instruction::Shl))
+        result->setHasNoSignedWrap();
+    return result;
 }
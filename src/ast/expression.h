@@ -1,10 +1,18 @@
 #ifndef EXPRESSION_H_INCLUDE
 #define EXPRESSION_H_INCLUDE
 
+#include <llvm/IR/Constant.h>
 #include "ast.h"
 
 class YacExpression: public YacSyntaxTreeNode {
 public:
+    // type of the expression before lvalue conversion, null if ill-formed;
+    // the value of generateRvalue() has type decay(type)
+    const YacType *type = nullptr;
+    // value of an arithmetic constant expression, folded when the expression
+    // is built; generateRvalue() returns it without emitting anything
+    llvm::Constant *constant = nullptr;
+
     // can return anything (value will not be used)
     // return nullptr on error or on no side effect expression
     llvm::Value* generate(YacSemanticAnalyzer &context) override {
@@ -13,13 +21,13 @@ public:
     // can return pointer to integer, float, pointer (aka pointer to first class)
     // return nullptr on error
     virtual llvm::Value *generateLvalue(YacSemanticAnalyzer &context) {
-        std::cerr << YacSemanticError("expression is not lvalue", this) << std::endl;
+        diagnostics() << YacSemanticError("expression is not lvalue", this) << std::endl;
         return nullptr;
     }
     // can return integer, float, pointer (aka first class)
     // return nullptr on error
     virtual llvm::Value *generateRvalue(YacSemanticAnalyzer &context) {
-        std::cerr << YacSemanticError("expression is not lvalue", this) << std::endl;
+        diagnostics() << YacSemanticError("expression is not lvalue", this) << std::endl;
         return nullptr;
     }
 };
@@ -34,6 +42,7 @@ class YacEmptyExpression: public YacExpression {
 };
 
 class YacLvalueExpression: public YacExpression {
+public:
     llvm::Value *generate(YacSemanticAnalyzer &context) override {
         return generateLvalue(context);
     }
@@ -41,6 +50,7 @@ class YacLvalueExpression: public YacExpression {
 };
 
 class YacRvalueExpression: public YacExpression {
+public:
     llvm::Value *generate(YacSemanticAnalyzer &context) override {
         return generateRvalue(context);
     }
@@ -49,10 +59,10 @@ class YacRvalueExpression: public YacExpression {
 
 class YacConstantExpression: public YacExpression {
 public:
-    llvm::Value *value;
-    explicit YacConstantExpression(llvm::Value *value);
+    llvm::Constant *value;
+    YacConstantExpression(llvm::Constant *value, const YacType *type);
     bool isString() {
-        return value->getType()->isArrayTy();
+        return type->isArray();
     }
     llvm::Value *generateRvalue(YacSemanticAnalyzer &context) override;
 };
@@ -64,8 +74,41 @@ public:
     YacExpression *func;
     YacExpressionList *args;
     explicit YacCallExpression(YacExpression *func, YacExpressionList *args = nullptr);
-    llvm::FunctionType *getFunc(llvm::Value *function, YacSemanticAnalyzer &context);
-    llvm::Value *doGenerate(llvm::Value *function, llvm::FunctionType *function_type, YacSemanticAnalyzer &context);
+    const YacFunctionType *getFunc();
+    llvm::Value *doGenerate(llvm::Value *function, const YacFunctionType *function_type, YacSemanticAnalyzer &context);
+    llvm::Value *generate(YacSemanticAnalyzer &context) override;
+    llvm::Value *generateRvalue(YacSemanticAnalyzer &context) override;
+};
+
+// `+', `-', `~' and `!'
+class YacUnaryExpression: public YacRvalueExpression {
+public:
+    YacExpression *operand;
+    int token;
+    YacUnaryExpression(YacExpression *operand, int token);
+    llvm::Value *generateRvalue(YacSemanticAnalyzer &context) override;
+};
+
+// `&operand'
+class YacAddressExpression: public YacRvalueExpression {
+public:
+    YacExpression *operand;
+    explicit YacAddressExpression(YacExpression *operand);
+    llvm::Value *generateRvalue(YacSemanticAnalyzer &context) override;
+};
+
+// `*operand'
+class YacIndirectionExpression: public YacLvalueExpression {
+public:
+    YacExpression *operand;
+    explicit YacIndirectionExpression(YacExpression *operand);
+    llvm::Value *generateLvalue(YacSemanticAnalyzer &context) override;
+};
+
+class YacCastExpression: public YacRvalueExpression {
+public:
+    YacExpression *operand;
+    YacCastExpression(const YacType *type, YacExpression *operand);
     llvm::Value *generate(YacSemanticAnalyzer &context) override;
     llvm::Value *generateRvalue(YacSemanticAnalyzer &context) override;
 };
@@ -78,31 +121,40 @@ public:
     int token;
     explicit YacBinaryExpression(YacExpression *left, YacExpression *right, int token);
     llvm::Value *generateRvalue(YacSemanticAnalyzer &context) override;
+private:
+    llvm::Value *generateLogical(YacSemanticAnalyzer &context);
 };
 
 class YacObjectExpression: public YacLvalueExpression {
 public:
     YacDeclaration *declaration;
     explicit YacObjectExpression(YacDeclaration *declaration);
+    // promoted objects have no address, generateLvalue() returns nullptr
     llvm::Value *generateLvalue(YacSemanticAnalyzer &context) override;
+    llvm::Value *generateRvalue(YacSemanticAnalyzer &context) override;
 };
 
-class YacAssignmentExpression: public YacLvalueExpression {
+// the value of an assignment is the value stored (it is not an lvalue in C)
+class YacAssignmentExpression: public YacRvalueExpression {
 public:
     YacExpression *left, *right;
     explicit YacAssignmentExpression(YacExpression *left, YacExpression *right);
-    llvm::Value *generateLvalue(YacSemanticAnalyzer &context) override;
+    llvm::Value *generateRvalue(YacSemanticAnalyzer &context) override;
 };
 
-class YacCompoundAssignmentExpression: public YacLvalueExpression {
+class YacCompoundAssignmentExpression: public YacRvalueExpression {
 public:
     YacExpression *left, *right;
     int token;
     explicit YacCompoundAssignmentExpression(YacExpression *left, YacExpression *right, int token);
-    llvm::Value *generateLvalue(YacSemanticAnalyzer &context) override;
+    llvm::Value *generateRvalue(YacSemanticAnalyzer &context) override;
 };
 
-bool binaryExpressionCheck(llvm::Value *left, llvm::Value *right, int token);
-llvm::Value *binaryExpression(llvm::Value *left, llvm::Value *right, int token, YacSemanticAnalyzer &context);
+// return the type of `left token right', nullptr if the operands are invalid;
+// the constant values of the operands, if any, tell null pointer constants
+const YacType *binaryExpressionCheck(const YacType *left, const YacType *right, int token,
+                                     llvm::Constant *left_constant = nullptr, llvm::Constant *right_constant = nullptr);
+llvm::Value *binaryExpression(llvm::Value *left, const YacType *left_type, llvm::Value *right, const YacType *right_type,
+                              int token, YacSemanticAnalyzer &context);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,16 @@
+#include "identifier.h"
+
+const YacIdentifier *YacIdentifierTable::get(llvm::StringRef spelling)
+{
+    auto &entry = *m_table.insert(std::make_pair(spelling, YacIdentifier())).first;
+    auto &identifier = entry.getValue();
+    if (identifier.m_spelling.data() == nullptr)
+        identifier.m_spelling = entry.getKey();
+    return &identifier;
+}
+
+const YacIdentifier *YacIdentifierTable::find(llvm::StringRef spelling) const
+{
+    auto iter = m_table.find(spelling);
+    return iter == m_table.end() ? nullptr : &iter->getValue();
+}
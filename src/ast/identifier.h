@@ -0,0 +1,33 @@
+#ifndef IDENTIFIER_H_INCLUDE
+#define IDENTIFIER_H_INCLUDE
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Allocator.h>
+
+// An interned identifier. The table hands out exactly one instance per
+// spelling, so identifiers are compared and hashed by address.
+class YacIdentifier {
+    friend class YacIdentifierTable;
+public:
+    llvm::StringRef str() const {
+        return m_spelling;
+    }
+private:
+    llvm::StringRef m_spelling; // points into the key stored by the table
+};
+
+class YacIdentifierTable {
+public:
+    // interns `spelling' on first use
+    const YacIdentifier *get(llvm::StringRef spelling);
+    // return nullptr if `spelling' has never been interned
+    const YacIdentifier *find(llvm::StringRef spelling) const;
+    size_t size() const {
+        return m_table.size();
+    }
+private:
+    llvm::StringMap<YacIdentifier, llvm::BumpPtrAllocator> m_table;
+};
+
+#endif
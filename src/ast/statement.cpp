@@ -11,19 +11,26 @@ YacReturnStatement::YacReturnStatement(YacExpression *expression)
 
 llvm::Value *YacReturnStatement::generate(YacSemanticAnalyzer &context)
 {
+    auto return_type = context.functionType()->result();
     if (expression == nullptr) {
-        if (context.function()->getReturnType()->isVoidTy())
-            return llvm::ReturnInst::Create(YacSemanticAnalyzer::context(), context.block());
-        std::cerr << "Non-void function should return a value" << std::endl;
+        if (return_type->isVoid())
+            return llvm::ReturnInst::Create(context.context(), context.block());
+        diagnostics() << "Non-void function should return a value" << std::endl;
     } else {
-        if (!context.function()->getReturnType()->isVoidTy()) {
+        if (!return_type->isVoid()) {
             auto value = expression->generateRvalue(context);
-            if (!value)
+            if (!value || !expression->type)
                 return nullptr;
-            return llvm::ReturnInst::Create(YacSemanticAnalyzer::context(),
-                                            castValueToType(value, context.function()->getReturnType(), context), context.block());
+            auto type = decay(expression->type);
+            if (!isImplicitlyConvertible(type, value, return_type)) {
+                diagnostics() << "yac: " << YacSemanticError("returning `" + type->name() + "' from a function with incompatible result type `"
+                                                             + return_type->name() + '\'', this) << std::endl;
+                return nullptr;
+            }
+            return llvm::ReturnInst::Create(context.context(), castValueToType(value, type, return_type, context),
+                                            context.block());
         }
-        std::cerr << "Void function should not return a value" << std::endl;
+        diagnostics() << "Void function should not return a value" << std::endl;
     }
     return nullptr;
 }
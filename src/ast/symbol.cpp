@@ -0,0 +1,54 @@
+#include <cassert>
+#include "symbol.h"
+
+// make_pair() takes it by reference
+const uint32_t YacSymbolTable::None;
+
+YacSymbolTable::YacSymbolTable()
+    : m_scopes{0} {}
+
+void YacSymbolTable::pushScope()
+{
+    m_scopes.push_back(static_cast<uint32_t>(m_bindings.size()));
+}
+
+void YacSymbolTable::popScope()
+{
+    assert(!m_scopes.empty());
+    auto begin = m_scopes.back();
+    m_scopes.pop_back();
+    for (auto index = m_bindings.size(); index-- > begin;) {
+        auto &binding = m_bindings[index];
+        // keep the key, it is likely to be declared again
+        m_table[binding.identifier] = binding.shadowed;
+    }
+    m_bindings.resize(begin);
+}
+
+bool YacSymbolTable::add(const YacIdentifier *identifier, YacDeclaration *declaration)
+{
+    assert(identifier && !m_scopes.empty());
+    auto depth = static_cast<uint32_t>(m_scopes.size());
+    auto &slot = m_table.insert(std::make_pair(identifier, None)).first->second;
+    if (slot != None && m_bindings[slot].depth == depth)
+        return false;
+    Binding binding;
+    binding.identifier = identifier;
+    binding.declaration = declaration;
+    binding.shadowed = slot;
+    binding.depth = depth;
+    slot = static_cast<uint32_t>(m_bindings.size());
+    m_bindings.push_back(binding);
+    return true;
+}
+
+YacDeclaration *YacSymbolTable::find(const YacIdentifier *identifier, unsigned int *depth) const
+{
+    auto iter = m_table.find(identifier);
+    if (iter == m_table.end() || iter->second == None)
+        return nullptr;
+    auto &binding = m_bindings[iter->second];
+    if (depth)
+        *depth = binding.depth;
+    return binding.declaration;
+}
@@ -0,0 +1,49 @@
+#ifndef SYMBOL_H_INCLUDE
+#define SYMBOL_H_INCLUDE
+
+#include <llvm/ADT/DenseMap.h>
+#include <cstdint>
+#include <vector>
+#include "identifier.h"
+
+class YacDeclaration;
+
+// Declarations visible at the current point of the parse. One hash table
+// maps every identifier to its innermost binding, and the bindings it hides
+// in outer scopes are chained behind it. Lookup is a single probe whatever
+// the nesting depth or the size of the file scope; popping a scope only
+// touches the declarations made in it.
+class YacSymbolTable {
+public:
+    YacSymbolTable();
+
+    void pushScope();
+    void popScope();
+    // number of open scopes, the file scope included
+    unsigned int depth() const {
+        return static_cast<unsigned int>(m_scopes.size());
+    }
+
+    // return false if `identifier' is already declared in the innermost scope
+    bool add(const YacIdentifier *identifier, YacDeclaration *declaration);
+    // return nullptr if `identifier' is not declared; `depth' receives the
+    // depth of the scope declaring it
+    YacDeclaration *find(const YacIdentifier *identifier, unsigned int *depth = nullptr) const;
+private:
+    static const uint32_t None = UINT32_MAX;
+    struct Binding {
+        const YacIdentifier *identifier;
+        YacDeclaration *declaration;
+        uint32_t shadowed; // index of the hidden binding of the same identifier
+        uint32_t depth;
+    };
+
+    // identifier -> index into m_bindings of its innermost binding
+    llvm::DenseMap<const YacIdentifier *, uint32_t> m_table;
+    // all live bindings, innermost scope last
+    std::vector<Binding> m_bindings;
+    // index into m_bindings of the first binding of each open scope
+    std::vector<uint32_t> m_scopes;
+};
+
+#endif
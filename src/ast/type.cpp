@@ -2,46 +2,47 @@
 #include <llvm/IR/Value.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Constants.h>
-#include <llvm/Support/raw_ostream.h>
 #include <iostream>
 #include "type.h"
 
-bool isValidVariableType(llvm::Type *type)
+bool isValidVariableType(const YacType *type)
 {
-    if (type->isArrayTy()) {
-        auto array_type = llvm::cast<llvm::ArrayType>(type);
-        if (array_type->getNumElements() == 0) {
-            std::cerr << "array length must be greater than zero" << std::endl;
+    if (type->isArray()) {
+        auto array_type = llvm::cast<YacArrayType>(type);
+        if (array_type->size() == 0) {
+            diagnostics() << "array length must be greater than zero" << std::endl;
             return false;
         }
-        return isValidVariableType(array_type->getElementType());
-    } else if (type->isPointerTy()) {
-        auto element_type = llvm::cast<llvm::PointerType>(type)->getElementType();
-        if (element_type->isVoidTy())
+        return isValidVariableType(array_type->element());
+    } else if (type->isPointer()) {
+        auto element_type = llvm::cast<YacPointerType>(type)->pointee();
+        if (element_type->isVoid())
             return true;
-        if (element_type->isFunctionTy())
-            return isValidFunctionType(llvm::cast<llvm::FunctionType>(element_type));
+        if (element_type->isFunction())
+            return isValidFunctionType(llvm::cast<YacFunctionType>(element_type));
+        if (element_type->isArray() && !llvm::cast<YacArrayType>(element_type)->size())
+            return isValidVariableType(llvm::cast<YacArrayType>(element_type)->element());
         return isValidVariableType(element_type);
     }
-    if (!type->isFirstClassType()) {
-        std::cerr << "variable has incomplete type" << std::endl;
+    if (type->isVoid() || type->isFunction()) {
+        diagnostics() << "variable has incomplete type `" << type->name() << '\'' << std::endl;
         return false;
     }
     return true;
 }
 
-bool isValidFunctionType(llvm::FunctionType *type)
+bool isValidFunctionType(const YacFunctionType *type)
 {
-    auto return_type = type->getReturnType();
-    if (return_type->isArrayTy()) {
-        std::cerr << "function cannot return array type" << std::endl;
+    auto return_type = type->result();
+    if (return_type->isArray()) {
+        diagnostics() << "function cannot return array type" << std::endl;
         return false;
     }
-    if (return_type->isFunctionTy()) {
-        std::cerr << "function cannot return function type" << std::endl;
+    if (return_type->isFunction()) {
+        diagnostics() << "function cannot return function type" << std::endl;
         return false;
     }
-    if (!return_type->isVoidTy() && !isValidVariableType(return_type))
+    if (!return_type->isVoid() && !isValidVariableType(return_type))
         return false;
     for (auto arg_type: type->params())
         if (!isValidVariableType(arg_type))
@@ -49,129 +50,234 @@ bool isValidFunctionType(llvm::FunctionType *type)
     return true;
 }
 
-llvm::Type *castToParameterType(llvm::Type *type)
+const YacType *castToParameterType(const YacType *type)
 {
-    if (type->isArrayTy())
-        return llvm::PointerType::getUnqual(llvm::cast<llvm::ArrayType>(type)->getElementType());
-    if (type->isFunctionTy())
-        return llvm::PointerType::getUnqual(type);
+    if (type->isArray())
+        return type->context().getPointer(llvm::cast<YacArrayType>(type)->element());
+    if (type->isFunction())
+        return type->context().getPointer(type);
     return type;
 }
 
-llvm::Value *castValueToType(llvm::Value *value, llvm::Type *type, YacSemanticAnalyzer &context)
+const YacType *decay(const YacType *type)
 {
-    if (value->getType() == type)
+    return castToParameterType(type)->unqualified();
+}
+
+static llvm::Instruction::CastOps getCastOpcode(const YacType *from, const YacType *to)
+{
+    if (from->isInteger()) {
+        if (to->isInteger()) {
+            auto from_bits = llvm::cast<YacIntegerType>(from)->bits(), to_bits = llvm::cast<YacIntegerType>(to)->bits();
+            if (from_bits > to_bits)
+                return llvm::Instruction::Trunc;
+            return from->isSigned() ? llvm::Instruction::SExt : llvm::Instruction::ZExt;
+        }
+        if (to->isFloating())
+            return from->isSigned() ? llvm::Instruction::SIToFP : llvm::Instruction::UIToFP;
+        return llvm::Instruction::IntToPtr;
+    }
+    if (from->isFloating()) {
+        if (to->isFloating())
+            return llvm::cast<YacFloatingType>(to)->isDouble() ? llvm::Instruction::FPExt : llvm::Instruction::FPTrunc;
+        return to->isSigned() ? llvm::Instruction::FPToSI : llvm::Instruction::FPToUI;
+    }
+    return to->isInteger() ? llvm::Instruction::PtrToInt : llvm::Instruction::BitCast;
+}
+
+llvm::Value *castValueToType(llvm::Value *value, const YacType *from, const YacType *to, YacSemanticAnalyzer &context)
+{
+    assert(value && from && to);
+    if (auto constant = llvm::dyn_cast<llvm::Constant>(value))
+        return castConstantToType(constant, from, to);
+    from = from->unqualified();
+    to = to->unqualified();
+    // e.g. `int' to `unsigned'
+    if (from == to || value->getType() == to->llvmType())
         return value;
-    auto code = llvm::CastInst::getCastOpcode(value, true, type, true);
-    return llvm::CastInst::Create(code, value, type, "", context.block());
+    assert(from->isScalar() && to->isScalar());
+    return llvm::CastInst::Create(getCastOpcode(from, to), value, to->llvmType(), "", context.block());
 }
 
-llvm::Value *castLvalueToRvalue(llvm::Value *value, YacSemanticAnalyzer &context) {
-    if (!value)
-        return nullptr;
-    assert(value->getType()->isPointerTy());
-    auto value_type = value->getType()->getPointerElementType();
-    if (value_type->isFunctionTy())
+llvm::Constant *castConstantToType(llvm::Constant *value, const YacType *from, const YacType *to)
+{
+    assert(value && from && to);
+    from = from->unqualified();
+    to = to->unqualified();
+    if (from == to || value->getType() == to->llvmType())
         return value;
-    if (value_type->isArrayTy())
-        return llvm::GetElementPtrInst::CreateInBounds(value, {
-                llvm::ConstantInt::get(llvm::Type::getInt32Ty(YacSemanticAnalyzer::context()), 0),
-                llvm::ConstantInt::get(llvm::Type::getInt32Ty(YacSemanticAnalyzer::context()), 0)
-        }, "", context.block());
-    if (value_type->isVoidTy()) {
-        std::cerr << "access void type" << std::endl;
-        return nullptr;
-    }
-    return new llvm::LoadInst(value, "", context.block());
+    assert(from->isScalar() && to->isScalar());
+    return llvm::ConstantExpr::getCast(getCastOpcode(from, to), value, to->llvmType());
+}
+
+llvm::Value *castValueToCondition(llvm::Value *value, const YacType *type, YacSemanticAnalyzer &context)
+{
+    assert(type->isScalar());
+    auto zero = llvm::Constant::getNullValue(value->getType());
+    if (type->isFloating())
+        return new llvm::FCmpInst(*context.block(), llvm::CmpInst::FCMP_UNE, value, zero);
+    return new llvm::ICmpInst(*context.block(), llvm::CmpInst::ICMP_NE, value, zero);
 }
 
-std::string getTypeName(llvm::Type *type)
+uint64_t sizeOf(const YacType *type)
 {
-    assert(type);
-    std::string str;
-    llvm::raw_string_ostream stream(str);
-    stream << *type;
-    return str;
+    switch (type->kind()) {
+        case YacType::Integer:
+            return llvm::cast<YacIntegerType>(type)->bits() / 8;
+        case YacType::Floating:
+            return llvm::cast<YacFloatingType>(type)->isDouble() ? 8 : 4;
+        case YacType::Pointer:
+            return 8;
+        case YacType::Array: {
+            auto array = llvm::cast<YacArrayType>(type);
+            return array->size() * sizeOf(array->element());
+        }
+        default:
+            return 0;
+    }
 }
 
-bool isObjectType(llvm::Type *type) {
-    return !type->isFunctionTy();
+llvm::Value *castLvalueToRvalue(llvm::Value *address, const YacType *type, YacSemanticAnalyzer &context) {
+    if (!address || !type)
+        return nullptr;
+    assert(address->getType()->isPointerTy());
+    if (type->isFunction())
+        return address;
+    if (type->isArray())
+        return llvm::GetElementPtrInst::CreateInBounds(address, {
+                llvm::ConstantInt::get(llvm::Type::getInt32Ty(context.context()), 0),
+                llvm::ConstantInt::get(llvm::Type::getInt32Ty(context.context()), 0)
+        }, "", context.block());
+    if (type->isVoid()) {
+        diagnostics() << "access void type" << std::endl;
+        return nullptr;
+    }
+    return new llvm::LoadInst(address, "", type->isVolatile(), context.block());
 }
 
-// http://en.cppreference.com/w/c/language/arithmetic_types
-bool isArithmeticType(llvm::Type *type) {
-    assert(type);
-    return type->isIntegerTy() || type->isFloatingPointTy();
+bool isObjectType(const YacType *type) {
+    return !type->isFunction();
 }
 
 // http://en.cppreference.com/w/c/types/NULL
-bool isNull(llvm::Value *value) {
-    assert(value);
-    if (llvm::isa<llvm::ConstantPointerNull>(value)) {
-        auto pointer = llvm::cast<llvm::ConstantPointerNull>(value);
-        return pointer->getType()->getElementType()->isVoidTy() && pointer->isNullValue();
-    }
-    return llvm::isa<llvm::ConstantInt>(value) && llvm::cast<llvm::ConstantInt>(value)->isNullValue();
+bool isNull(const YacType *type, llvm::Value *value) {
+    assert(type && value);
+    auto constant = llvm::dyn_cast<llvm::Constant>(value);
+    if (!constant || !constant->isNullValue())
+        return false;
+    if (type->isPointer())
+        return llvm::cast<YacPointerType>(type)->pointee()->unqualified()->isVoid();
+    return type->isInteger();
 }
 
 // http://en.cppreference.com/w/c/language/type#Compatible_types
-bool isCompatible(llvm::Type *left, llvm::Type *right) {
+bool isCompatible(const YacType *left, const YacType *right) {
     assert(left && right);
-    if (left == right
-            || (left->isPointerTy() && right->isPointerTy() && isCompatible(left->getPointerElementType(), right->getPointerElementType()))
-            || ((left->isArrayTy() && right->isArrayTy() && isCompatible(left->getArrayElementType(), right->getArrayElementType()))
-               && (!left->getArrayNumElements() || !right->getArrayNumElements() || left->getArrayNumElements() == right->getArrayNumElements())))
+    if (left == right)
         return true;
-    if (left->isFunctionTy() && right->isFunctionTy()) {
-        //auto left_func = llvm::cast<llvm::FunctionType>(left), right_func = llvm::cast<llvm::FunctionType>(right);
-        // TODO
+    if (left->qualifiers() != right->qualifiers() || left->kind() != right->kind())
+        return false;
+    left = left->unqualified();
+    right = right->unqualified();
+    switch (left->kind()) {
+        case YacType::Pointer:
+            return isCompatible(llvm::cast<YacPointerType>(left)->pointee(), llvm::cast<YacPointerType>(right)->pointee());
+        case YacType::Array: {
+            auto left_array = llvm::cast<YacArrayType>(left), right_array = llvm::cast<YacArrayType>(right);
+            return isCompatible(left_array->element(), right_array->element())
+                   && (!left_array->size() || !right_array->size() || left_array->size() == right_array->size());
+        }
+        case YacType::Function: {
+            auto left_function = llvm::cast<YacFunctionType>(left), right_function = llvm::cast<YacFunctionType>(right);
+            if (left_function->isVarArg() != right_function->isVarArg()
+                    || left_function->params().size() != right_function->params().size()
+                    || !isCompatible(left_function->result(), right_function->result()))
+                return false;
+            for (size_t i = 0; i < left_function->params().size(); ++i)
+                if (!isCompatible(left_function->params()[i]->unqualified(), right_function->params()[i]->unqualified()))
+                    return false;
+            return true;
+        }
+        default:
+            return false;
     }
-    return false;
 }
 
-
 // http://en.cppreference.com/w/c/language/operator_assignment
-bool isImplicitlyConvertible(llvm::Value *value, llvm::Type *dst_type) {
-    assert(value && dst_type);
-    auto src_type = value->getType();
-    return (src_type == dst_type
-           || (isArithmeticType(src_type) && isArithmeticType(dst_type)))
-           || (dst_type->isPointerTy() && ((src_type->isPointerTy() &&
-            isCompatible(src_type->getPointerElementType(), dst_type->getPointerElementType())) || isNull(value)));
+bool isImplicitlyConvertible(const YacType *src_type, llvm::Value *value, const YacType *dst_type) {
+    assert(src_type && value && dst_type);
+    src_type = src_type->unqualified();
+    dst_type = dst_type->unqualified();
+    if (src_type == dst_type || (src_type->isArithmetic() && dst_type->isArithmetic()))
+        return true;
+    if (!dst_type->isPointer())
+        return false;
+    if (isNull(src_type, value))
+        return true;
+    if (!src_type->isPointer())
+        return false;
+    auto src_pointee = llvm::cast<YacPointerType>(src_type)->pointee(),
+            dst_pointee = llvm::cast<YacPointerType>(dst_type)->pointee();
+    // the pointed type may only gain qualifiers
+    if ((src_pointee->qualifiers() & ~dst_pointee->qualifiers()) != 0)
+        return false;
+    src_pointee = src_pointee->unqualified();
+    dst_pointee = dst_pointee->unqualified();
+    return src_pointee->isVoid() || dst_pointee->isVoid() || isCompatible(src_pointee, dst_pointee);
+}
+
+// http://en.cppreference.com/w/c/language/cast
+bool isExplicitlyConvertible(const YacType *src_type, const YacType *dst_type) {
+    assert(src_type && dst_type);
+    src_type = src_type->unqualified();
+    dst_type = dst_type->unqualified();
+    if (dst_type->isVoid())
+        return true;
+    if (!src_type->isScalar() || !dst_type->isScalar())
+        return false;
+    return !(src_type->isFloating() && dst_type->isPointer()) && !(src_type->isPointer() && dst_type->isFloating());
+}
+
+// http://en.cppreference.com/w/c/language/conversion#Integer_promotions
+const YacType *integerPromotion(const YacType *type) {
+    type = type->unqualified();
+    if (type->isInteger() && llvm::cast<YacIntegerType>(type)->rank() < YacIntegerType::Int)
+        return type->context().getInt();
+    return type;
 }
 
 // refer http://en.cppreference.com/w/c/language/conversion#Usual_arithmetic_conversions
-void usualArithmeticConversions(llvm::Value *&left, llvm::Value *&right, YacSemanticAnalyzer &context)
+const YacType *usualArithmeticConversions(const YacType *left, const YacType *right)
 {
     assert(left && right);
-    auto left_type = left->getType(), right_type = right->getType();
-    assert(isArithmeticType(left_type) && isArithmeticType(right_type));
-    llvm::Type *result_type;
-    if (left_type->isFloatingPointTy() == right_type->isFloatingPointTy()) {
-        auto left_size = left_type->getPrimitiveSizeInBits(), right_size = right_type->getPrimitiveSizeInBits();
-        assert(left_size && right_size);
-        result_type = left_size > right_size ? left_type : right_type;
-    } else
-        result_type = left_type->isFloatingPointTy() ? left_type : right_type;
-    cast(left, result_type, context);
-    cast(right, result_type, context);
-}
-
-bool isExplicitlyConvertible(llvm::Type *src_type, llvm::Type *dst_type) {
-    return false;
-}
-
-void cast(llvm::Value *&value, llvm::Type *type, YacSemanticAnalyzer &context) {
-    assert(value && type);
-    assert(isExplicitlyConvertible(value->getType(), type));
-    auto code = llvm::CastInst::getCastOpcode(value, true, type, true);
-    if (llvm::isa<llvm::ConstantInt>(value)) {
-        auto constant = llvm::cast<llvm::ConstantInt>(value);
-        if (type->isIntegerTy())
-            value = llvm::ConstantInt::get(llvm::cast<llvm::IntegerType>(type), constant->getLimitedValue(), true);
-        else if (type->isPointerTy() && constant->isNullValue()) {
-            value = llvm::ConstantInt::get(llvm::cast<llvm::IntegerType>(type), constant->getLimitedValue(), true);
-        }
+    assert(left->isArithmetic() && right->isArithmetic());
+    auto &types = left->context();
+    if (left->isFloating() || right->isFloating()) {
+        bool is_double = (left->isFloating() && llvm::cast<YacFloatingType>(left)->isDouble())
+                || (right->isFloating() && llvm::cast<YacFloatingType>(right)->isDouble());
+        return types.getFloating(is_double);
     }
-    value = llvm::CastInst::Create(code, value, type, "", context.block());
+    auto left_integer = llvm::cast<YacIntegerType>(integerPromotion(left)),
+            right_integer = llvm::cast<YacIntegerType>(integerPromotion(right));
+    if (left_integer == right_integer)
+        return left_integer;
+    if (left_integer->isSigned() == right_integer->isSigned())
+        return left_integer->rank() > right_integer->rank() ? left_integer : right_integer;
+    auto is_unsigned = left_integer->isSigned() ? right_integer : left_integer,
+            is_signed = left_integer->isSigned() ? left_integer : right_integer;
+    if (is_unsigned->rank() >= is_signed->rank())
+        return is_unsigned;
+    // the signed type can represent all the values of the unsigned one
+    if (is_signed->bits() > is_unsigned->bits())
+        return is_signed;
+    return types.getInteger(is_signed->rank(), false);
+}
+
+// http://en.cppreference.com/w/c/language/conversion#Default_argument_promotions
+const YacType *defaultArgumentPromotion(const YacType *type)
+{
+    type = integerPromotion(decay(type));
+    if (type->isFloating())
+        return type->context().getFloating(true);
+    return type;
 }
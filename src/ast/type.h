@@ -3,35 +3,45 @@
 
 #include <llvm/IR/DerivedTypes.h>
 
+#include "types.h"
 #include "context.h"
 
-bool isValidVariableType(llvm::Type *type);
-bool isValidFunctionType(llvm::FunctionType *type);
+bool isValidVariableType(const YacType *type);
+bool isValidFunctionType(const YacFunctionType *type);
 
-llvm::Type *castToParameterType(llvm::Type *type);
+// adjusts arrays and functions to pointers
+const YacType *castToParameterType(const YacType *type);
+// type of the rvalue of an expression of type `type'
+const YacType *decay(const YacType *type);
 
-llvm::Value *castValueToType(llvm::Value *value, llvm::Type *type, YacSemanticAnalyzer &context);
+// converts `value' of type `from' to `to', constants are folded
+llvm::Value *castValueToType(llvm::Value *value, const YacType *from, const YacType *to, YacSemanticAnalyzer &context);
+llvm::Constant *castConstantToType(llvm::Constant *value, const YacType *from, const YacType *to);
+// the i1 telling whether the scalar `value' compares unequal to 0
+llvm::Value *castValueToCondition(llvm::Value *value, const YacType *type, YacSemanticAnalyzer &context);
 
-llvm::Value *castLvalueToRvalue(llvm::Value *value, YacSemanticAnalyzer &context);
+// size in bytes on the target, 0 for void, functions and arrays of unknown size
+uint64_t sizeOf(const YacType *type);
 
-std::string getTypeName(llvm::Type *type);
+// loads the object of type `type' at `address'
+llvm::Value *castLvalueToRvalue(llvm::Value *address, const YacType *type, YacSemanticAnalyzer &context);
 
 /******** Following functions ensure to be ANSI C subset in our system ********/
 // It is always asserted that all inputs are valid (not null, valid value category etc.).
 // And it can be asserted that all output are also valid.
 
 /**** Type Category ****/
-bool isObjectType(llvm::Type *type);
-bool isArithmeticType(llvm::Type *type);
-bool isNull(llvm::Value *value);
+bool isObjectType(const YacType *type);
+bool isNull(const YacType *type, llvm::Value *value);
 
 /**** Conversion ****/
-bool isCompatible(llvm::Type *left, llvm::Type *right);
-bool isImplicitlyConvertible(llvm::Value *value, llvm::Type *dst_type);
-bool isExplicitlyConvertible(llvm::Type *src_type, llvm::Type *dst_type);
-void usualArithmeticConversions(llvm::Value *&left, llvm::Value *&right, YacSemanticAnalyzer &context);
-
-/**** Expression ****/
-void cast(llvm::Value *&value, llvm::Type *type, YacSemanticAnalyzer &context);
-
-#endif
\ No newline at end of file
+bool isCompatible(const YacType *left, const YacType *right);
+bool isImplicitlyConvertible(const YacType *src_type, llvm::Value *value, const YacType *dst_type);
+bool isExplicitlyConvertible(const YacType *src_type, const YacType *dst_type);
+const YacType *integerPromotion(const YacType *type);
+// return the common real type of `left' and `right'
+const YacType *usualArithmeticConversions(const YacType *left, const YacType *right);
+// promotions of the arguments matching `...'
+const YacType *defaultArgumentPromotion(const YacType *type);
+
+#endif
@@ -0,0 +1,231 @@
+#include <llvm/IR/Type.h>
+#include <llvm/Support/Casting.h>
+#include <algorithm>
+#include "types.h"
+
+bool YacType::isSigned() const {
+    if (isInteger())
+        return llvm::cast<YacIntegerType>(this)->isSigned();
+    return isFloating();
+}
+
+unsigned int YacIntegerType::bits() const {
+    switch (m_rank) {
+        case Char:  return 8;
+        case Short: return 16;
+        case Int:   return 32;
+        default:    return 64;
+    }
+}
+
+static std::string qualifierPrefix(unsigned int qualifiers) {
+    std::string result;
+    if (qualifiers & YacType::Const)
+        result += "const ";
+    if (qualifiers & YacType::Volatile)
+        result += "volatile ";
+    return result;
+}
+
+// `inner' is the declarator built so far, as in `(*)[3]'
+static std::string spell(const YacType *type, const std::string &inner) {
+    switch (type->kind()) {
+        case YacType::Pointer: {
+            auto pointee = llvm::cast<YacPointerType>(type)->pointee();
+            std::string declarator = "*";
+            if (type->qualifiers()) {
+                declarator += " " + qualifierPrefix(type->qualifiers());
+                if (inner.empty())
+                    declarator.pop_back();
+            }
+            declarator += inner;
+            if (pointee->isArray() || pointee->isFunction())
+                declarator = "(" + declarator + ")";
+            return spell(pointee, declarator);
+        }
+        case YacType::Array: {
+            auto array = llvm::cast<YacArrayType>(type);
+            return spell(array->element(),
+                         inner + "[" + (array->size() ? std::to_string(array->size()) : std::string()) + "]");
+        }
+        case YacType::Function: {
+            auto function = llvm::cast<YacFunctionType>(type);
+            std::string params;
+            for (auto param: function->params())
+                params += (params.empty() ? "" : ", ") + spell(param, "");
+            if (function->isVarArg())
+                params += params.empty() ? "..." : ", ...";
+            else if (params.empty())
+                params = "void";
+            return spell(function->result(), inner + "(" + params + ")");
+        }
+        default:
+            break;
+    }
+    std::string base;
+    if (type->isVoid())
+        base = "void";
+    else if (type->isFloating())
+        base = llvm::cast<YacFloatingType>(type)->isDouble() ? "double" : "float";
+    else {
+        static const char *const names[] = {"char", "short", "int", "long", "long long"};
+        auto integer = llvm::cast<YacIntegerType>(type);
+        base = (integer->isSigned() ? "" : "unsigned ") + std::string(names[integer->rank()]);
+    }
+    base = qualifierPrefix(type->qualifiers()) + base;
+    return inner.empty() ? base : base + " " + inner;
+}
+
+std::string YacType::name() const {
+    return spell(this, "");
+}
+
+void YacType::Profile(llvm::FoldingSetNodeID &id) const {
+    id.AddInteger(m_kind);
+    id.AddInteger(m_qualifiers);
+    if (m_qualifiers) {
+        id.AddPointer(m_unqualified);
+        return;
+    }
+    switch (m_kind) {
+        case Integer: {
+            auto integer = llvm::cast<YacIntegerType>(this);
+            id.AddInteger(integer->rank());
+            id.AddBoolean(integer->isSigned());
+            break;
+        }
+        case Floating:
+            id.AddBoolean(llvm::cast<YacFloatingType>(this)->isDouble());
+            break;
+        case Pointer:
+            id.AddPointer(llvm::cast<YacPointerType>(this)->pointee());
+            break;
+        case Array: {
+            auto array = llvm::cast<YacArrayType>(this);
+            id.AddPointer(array->element());
+            id.AddInteger(array->size());
+            break;
+        }
+        case Function: {
+            auto function = llvm::cast<YacFunctionType>(this);
+            id.AddPointer(function->result());
+            id.AddBoolean(function->isVarArg());
+            id.AddInteger(function->params().size());
+            for (auto param: function->params())
+                id.AddPointer(param);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+
+YacTypeContext::YacTypeContext(llvm::LLVMContext &context)
+    : m_context(context), m_void(intern(YacType(YacType::Void))) {}
+
+template <typename T>
+const T *YacTypeContext::intern(const T &type) {
+    llvm::FoldingSetNodeID id;
+    type.Profile(id);
+    void *insert_pos;
+    if (auto found = m_types.FindNodeOrInsertPos(id, insert_pos))
+        return llvm::cast<T>(found);
+    auto result = new (m_allocator.Allocate<T>()) T(type);
+    result->SetNextInBucket(nullptr);
+    result->m_context = this;
+    if (!result->m_qualifiers)
+        result->m_unqualified = result;
+    adopt(result);
+    result->m_llvm_type = lower(result);
+    m_types.InsertNode(result, insert_pos);
+    return result;
+}
+
+void YacTypeContext::adopt(YacFunctionType *type) {
+    // the parameters came from the caller
+    auto params = m_allocator.Allocate<const YacType *>(type->m_params.size());
+    std::copy(type->m_params.begin(), type->m_params.end(), params);
+    type->m_params = llvm::makeArrayRef(params, type->m_params.size());
+}
+
+llvm::Type *YacTypeContext::lower(const YacType *type) {
+    if (type->qualifiers())
+        return type->unqualified()->llvmType();
+    switch (type->kind()) {
+        case YacType::Void:
+            return llvm::Type::getVoidTy(m_context);
+        case YacType::Integer:
+            return llvm::Type::getIntNTy(m_context, llvm::cast<YacIntegerType>(type)->bits());
+        case YacType::Floating:
+            if (llvm::cast<YacFloatingType>(type)->isDouble())
+                return llvm::Type::getDoubleTy(m_context);
+            return llvm::Type::getFloatTy(m_context);
+        case YacType::Pointer: {
+            auto pointee = llvm::cast<YacPointerType>(type)->pointee();
+            return llvm::PointerType::getUnqual(pointee->isVoid() ? llvm::Type::getInt8Ty(m_context)
+                                                                  : pointee->llvmType());
+        }
+        case YacType::Array: {
+            auto array = llvm::cast<YacArrayType>(type);
+            return llvm::ArrayType::get(array->element()->llvmType(), array->size());
+        }
+        case YacType::Function: {
+            auto function = llvm::cast<YacFunctionType>(type);
+            std::vector<llvm::Type *> params;
+            for (auto param: function->params())
+                params.push_back(param->llvmType());
+            return llvm::FunctionType::get(function->result()->llvmType(), params, function->isVarArg());
+        }
+    }
+    return nullptr;
+}
+
+const YacIntegerType *YacTypeContext::getInteger(YacIntegerType::Rank rank, bool is_signed) {
+    return intern(YacIntegerType(rank, is_signed));
+}
+
+const YacFloatingType *YacTypeContext::getFloating(bool is_double) {
+    return intern(YacFloatingType(is_double));
+}
+
+const YacPointerType *YacTypeContext::getPointer(const YacType *pointee) {
+    return intern(YacPointerType(pointee));
+}
+
+const YacArrayType *YacTypeContext::getArray(const YacType *element, uint64_t size) {
+    return intern(YacArrayType(element, size));
+}
+
+const YacFunctionType *YacTypeContext::getFunction(const YacType *result, llvm::ArrayRef<const YacType *> params,
+                                                   bool var_arg) {
+    return intern(YacFunctionType(result, params, var_arg));
+}
+
+template <typename T>
+const YacType *YacTypeContext::internQualified(const YacType *type, unsigned int qualifiers) {
+    T copy(*llvm::cast<T>(type));
+    copy.m_qualifiers = qualifiers;
+    copy.m_unqualified = type;
+    return intern(copy);
+}
+
+const YacType *YacTypeContext::getQualified(const YacType *type, unsigned int qualifiers) {
+    // qualifiers of an array apply to its elements, which may be qualified
+    // even though the array itself is not
+    if (type->isArray()) {
+        auto array = llvm::cast<YacArrayType>(type->unqualified());
+        return getArray(getQualified(array->element(), qualifiers), array->size());
+    }
+    if (type->qualifiers() == qualifiers)
+        return type;
+    type = type->unqualified();
+    if (!qualifiers || type->isFunction())
+        return type;
+    switch (type->kind()) {
+        case YacType::Integer:  return internQualified<YacIntegerType>(type, qualifiers);
+        case YacType::Floating: return internQualified<YacFloatingType>(type, qualifiers);
+        case YacType::Pointer:  return internQualified<YacPointerType>(type, qualifiers);
+        default:                return internQualified<YacType>(type, qualifiers);
+    }
+}
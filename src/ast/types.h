@@ -0,0 +1,249 @@
+#ifndef TYPES_H_INCLUDE
+#define TYPES_H_INCLUDE
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/FoldingSet.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/Support/Allocator.h>
+#include <cstdint>
+#include <string>
+
+class YacTypeContext;
+
+// A C type. Types are interned by a YacTypeContext, so two types are the
+// same if and only if their pointers are equal. Every type knows its LLVM
+// lowering, but semantic decisions are made on YacType only.
+class YacType: public llvm::FoldingSetNode {
+    friend class YacTypeContext;
+public:
+    enum Kind {
+        Void,
+        Integer,
+        Floating,
+        Pointer,
+        Array,
+        Function,
+    };
+    enum Qualifiers {
+        Const    = 1 << 0,
+        Volatile = 1 << 1,
+    };
+
+    Kind kind() const {
+        return m_kind;
+    }
+    YacTypeContext &context() const {
+        return *m_context;
+    }
+    // lowered once when the type is created, `void *' becomes `i8 *'
+    llvm::Type *llvmType() const {
+        return m_llvm_type;
+    }
+
+    unsigned int qualifiers() const {
+        return m_qualifiers;
+    }
+    bool isConst() const {
+        return (m_qualifiers & Const) != 0;
+    }
+    bool isVolatile() const {
+        return (m_qualifiers & Volatile) != 0;
+    }
+    const YacType *unqualified() const {
+        return m_unqualified;
+    }
+
+    bool isVoid() const {
+        return m_kind == Void;
+    }
+    bool isInteger() const {
+        return m_kind == Integer;
+    }
+    bool isFloating() const {
+        return m_kind == Floating;
+    }
+    bool isArithmetic() const {
+        return m_kind == Integer || m_kind == Floating;
+    }
+    bool isPointer() const {
+        return m_kind == Pointer;
+    }
+    bool isScalar() const {
+        return isArithmetic() || isPointer();
+    }
+    bool isArray() const {
+        return m_kind == Array;
+    }
+    bool isFunction() const {
+        return m_kind == Function;
+    }
+    bool isSigned() const;
+
+    // as written in C, e.g. `const char *'
+    std::string name() const;
+
+    void Profile(llvm::FoldingSetNodeID &id) const;
+protected:
+    YacType(Kind kind)
+        : m_kind(kind), m_qualifiers(0), m_context(nullptr), m_unqualified(this), m_llvm_type(nullptr) {}
+private:
+    Kind m_kind;
+    unsigned int m_qualifiers;
+    YacTypeContext *m_context;
+    const YacType *m_unqualified;
+    llvm::Type *m_llvm_type;
+};
+
+class YacIntegerType: public YacType {
+public:
+    // conversion ranks, char is signed on the target
+    enum Rank {
+        Char,
+        Short,
+        Int,
+        Long,
+        LongLong,
+    };
+
+    YacIntegerType(Rank rank, bool is_signed)
+        : YacType(Integer), m_rank(rank), m_signed(is_signed) {}
+    Rank rank() const {
+        return m_rank;
+    }
+    bool isSigned() const {
+        return m_signed;
+    }
+    unsigned int bits() const;
+
+    static bool classof(const YacType *type) {
+        return type->kind() == Integer;
+    }
+private:
+    Rank m_rank;
+    bool m_signed;
+};
+
+class YacFloatingType: public YacType {
+public:
+    explicit YacFloatingType(bool is_double)
+        : YacType(Floating), m_double(is_double) {}
+    bool isDouble() const {
+        return m_double;
+    }
+
+    static bool classof(const YacType *type) {
+        return type->kind() == Floating;
+    }
+private:
+    bool m_double;
+};
+
+class YacPointerType: public YacType {
+public:
+    explicit YacPointerType(const YacType *pointee)
+        : YacType(Pointer), m_pointee(pointee) {}
+    const YacType *pointee() const {
+        return m_pointee;
+    }
+
+    static bool classof(const YacType *type) {
+        return type->kind() == Pointer;
+    }
+private:
+    const YacType *m_pointee;
+};
+
+class YacArrayType: public YacType {
+public:
+    YacArrayType(const YacType *element, uint64_t size)
+        : YacType(Array), m_element(element), m_size(size) {}
+    const YacType *element() const {
+        return m_element;
+    }
+    // 0 if unknown
+    uint64_t size() const {
+        return m_size;
+    }
+
+    static bool classof(const YacType *type) {
+        return type->kind() == Array;
+    }
+private:
+    const YacType *m_element;
+    uint64_t m_size;
+};
+
+class YacFunctionType: public YacType {
+public:
+    YacFunctionType(const YacType *result, llvm::ArrayRef<const YacType *> params, bool var_arg)
+        : YacType(Function), m_result(result), m_params(params), m_var_arg(var_arg) {}
+    const YacType *result() const {
+        return m_result;
+    }
+    llvm::ArrayRef<const YacType *> params() const {
+        return m_params;
+    }
+    bool isVarArg() const {
+        return m_var_arg;
+    }
+    llvm::FunctionType *llvmFunctionType() const {
+        return llvm::cast<llvm::FunctionType>(llvmType());
+    }
+
+    static bool classof(const YacType *type) {
+        return type->kind() == Function;
+    }
+private:
+    friend class YacTypeContext;
+    const YacType *m_result;
+    llvm::ArrayRef<const YacType *> m_params;  // owned by the context once interned
+    bool m_var_arg;
+};
+
+// Owns and interns all the types of a translation unit.
+class YacTypeContext {
+public:
+    explicit YacTypeContext(llvm::LLVMContext &context);
+    YacTypeContext(const YacTypeContext &) = delete;
+    YacTypeContext &operator = (const YacTypeContext &) = delete;
+
+    llvm::LLVMContext &context() {
+        return m_context;
+    }
+
+    const YacType *getVoid() {
+        return m_void;
+    }
+    const YacIntegerType *getInteger(YacIntegerType::Rank rank, bool is_signed);
+    const YacIntegerType *getChar() {
+        return getInteger(YacIntegerType::Char, true);
+    }
+    const YacIntegerType *getInt() {
+        return getInteger(YacIntegerType::Int, true);
+    }
+    const YacIntegerType *getLong() {
+        return getInteger(YacIntegerType::Long, true);
+    }
+    const YacFloatingType *getFloating(bool is_double);
+    const YacPointerType *getPointer(const YacType *pointee);
+    const YacArrayType *getArray(const YacType *element, uint64_t size);
+    const YacFunctionType *getFunction(const YacType *result, llvm::ArrayRef<const YacType *> params, bool var_arg);
+    // `type' with exactly `qualifiers' (YacType::Qualifiers)
+    const YacType *getQualified(const YacType *type, unsigned int qualifiers);
+private:
+    template <typename T>
+    const T *intern(const T &type);
+    template <typename T>
+    const YacType *internQualified(const YacType *type, unsigned int qualifiers);
+    void adopt(YacType *type) {}
+    void adopt(YacFunctionType *type);
+    llvm::Type *lower(const YacType *type);
+
+    llvm::LLVMContext &m_context;
+    llvm::BumpPtrAllocator m_allocator;
+    llvm::FoldingSet<YacType> m_types;
+    const YacType *m_void;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Support/CachePruning.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Process.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/raw_ostream.h>
+#include <chrono>
+#include "cache.h"
+
+YacObjectCache::YacObjectCache(std::string directory, std::string salt, uint64_t max_size)
+    : m_directory(std::move(directory)), m_salt(std::move(salt)), m_max_size(max_size) {}
+
+// the same for getObject() and the notifyObjectCompiled() following it
+const std::string &YacObjectCache::path(const llvm::Module *module) {
+    auto &path = m_paths[module];
+    if (path.empty()) {
+        llvm::SmallVector<char, 0> bitcode;
+        llvm::raw_svector_ostream out(bitcode);
+        llvm::WriteBitcodeToFile(*module, out);
+        llvm::SHA1 hasher;
+        hasher.update(m_salt);
+        hasher.update(llvm::StringRef(bitcode.data(), bitcode.size()));
+        // pruneCache() only considers files named `llvmcache-*'
+        llvm::SmallString<128> result(m_directory);
+        llvm::sys::path::append(result, "llvmcache-" + llvm::toHex(hasher.final(), true));
+        path.assign(result.begin(), result.end());
+    }
+    return path;
+}
+
+std::unique_ptr<llvm::MemoryBuffer> YacObjectCache::getObject(const llvm::Module *module) {
+    auto &path = this->path(module);
+    int fd;
+    if (llvm::sys::fs::openFileForRead(path, fd))
+        return nullptr;
+    // the access time orders the entries for pruning
+    llvm::sys::fs::setLastModificationAndAccessTime(fd, std::chrono::system_clock::now());
+    auto buffer = llvm::MemoryBuffer::getOpenFile(fd, path, -1, false);
+    llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+    if (!buffer)
+        return nullptr;
+    return std::move(*buffer);
+}
+
+void YacObjectCache::notifyObjectCompiled(const llvm::Module *module, llvm::MemoryBufferRef object) {
+    // a cache that cannot be written is only slower
+    if (llvm::sys::fs::create_directories(m_directory))
+        return;
+    llvm::SmallString<128> model(m_directory);
+    llvm::sys::path::append(model, "yac-%%%%%%%%.tmp");
+    auto temp = llvm::sys::fs::TempFile::create(model);
+    if (!temp) {
+        llvm::consumeError(temp.takeError());
+        return;
+    }
+    {
+        llvm::raw_fd_ostream out(temp->FD, false);
+        out << object.getBuffer();
+    }
+    // atomic, a concurrent writer of the same entry wrote the same object
+    if (auto error = temp->keep(path(module))) {
+        llvm::consumeError(std::move(error));
+        llvm::consumeError(temp->discard());
+    }
+}
+
+void YacObjectCache::prune() {
+    llvm::CachePruningPolicy policy;
+    policy.MaxSizeBytes = m_max_size;
+    if (!m_max_size)
+        policy.MaxSizePercentageOfAvailableSpace = 0;
+    llvm::pruneCache(m_directory, policy);
+}
@@ -0,0 +1,40 @@
+#ifndef CACHE_H_INCLUDE
+#define CACHE_H_INCLUDE
+
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+// Objects compiled by the JIT, kept in a directory shared by every yac
+// process. An object is named after the SHA-1 of the module bitcode and of
+// `salt', which must cover everything else the object depends on (target,
+// CPU, optimization level...).
+//
+// Entries are written to a temporary file and renamed into place, so a
+// reader sees either no entry or a complete one. Reading an entry refreshes
+// its access time and prune() removes the least recently used ones, which is
+// safe against readers since an open file outlives its removal.
+class YacObjectCache: public llvm::ObjectCache {
+public:
+    // `max_size' in bytes, 0 for no limit
+    YacObjectCache(std::string directory, std::string salt, uint64_t max_size);
+
+    void notifyObjectCompiled(const llvm::Module *module, llvm::MemoryBufferRef object) override;
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *module) override;
+
+    // removes entries until the directory fits in the size limit, at most
+    // once every 20 minutes across all the processes
+    void prune();
+private:
+    const std::string &path(const llvm::Module *module);
+
+    std::string m_directory, m_salt;
+    uint64_t m_max_size;
+    std::map<const llvm::Module *, std::string> m_paths;
+};
+
+#endif
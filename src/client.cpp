@@ -0,0 +1,94 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <climits>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "transport.h"
+
+extern char **environ;
+
+static int server_connection = -1;
+// the last signal passed on to the server
+static volatile sig_atomic_t forwarded_signal = 0;
+
+// The request runs in a process of the server, out of reach of the terminal,
+// so the signals meant for it are written to the server.
+static void forwardSignal(int number) {
+    unsigned char byte = static_cast<unsigned char>(number);
+    if (write(server_connection, &byte, 1) == 1)
+        forwarded_signal = number;
+}
+
+static int connectServer(const char *path) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (std::strlen(path) >= sizeof(address.sun_path))
+        return -1;
+    std::strcpy(address.sun_path, path);
+    int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection >= 0 && connect(connection, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+        close(connection);
+        connection = -1;
+    }
+    return connection;
+}
+
+// Stands in for yac: the command line runs on the server listening at
+// $YAC_SERVER (see `yac --serve'), or in yac itself if there is none. This
+// program does not link LLVM, so it starts at once.
+int main(int argc, char **argv) {
+    const char *path = std::getenv("YAC_SERVER");
+    int connection = path && *path ? connectServer(path) : -1;
+    if (connection < 0) {
+        // the yac next to this program, else the one in PATH
+        char self[PATH_MAX];
+        auto length = readlink("/proc/self/exe", self, sizeof(self) - 1);
+        if (length > 0) {
+            std::string yac(self, static_cast<size_t>(length));
+            yac = yac.substr(0, yac.rfind('/') + 1) + "yac";
+            argv[0] = &yac[0];
+            execv(yac.c_str(), argv);
+        }
+        argv[0] = const_cast<char *>("yac");
+        execvp("yac", argv);
+        std::cerr << "yac-client: cannot run yac" << std::endl;
+        return 127;
+    }
+
+    YacRequest request;
+    char directory[PATH_MAX];
+    if (!getcwd(directory, sizeof(directory))) {
+        std::cerr << "yac-client: cannot get the current directory" << std::endl;
+        return 1;
+    }
+    request.directory = directory;
+    request.args.assign(argv + 1, argv + argc);
+    for (auto variable = environ; *variable; ++variable)
+        request.environment.emplace_back(*variable);
+    if (!sendRequest(connection, request)) {
+        std::cerr << "yac-client: the server at `" << path << "' failed" << std::endl;
+        return 1;
+    }
+    server_connection = connection;
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = forwardSignal;
+    sigemptyset(&action.sa_mask);
+    for (int number: {SIGINT, SIGTERM, SIGHUP, SIGQUIT})
+        sigaction(number, &action, nullptr);
+    int status;
+    if (!receiveStatus(connection, status)) {
+        std::cerr << "yac-client: the server at `" << path << "' failed" << std::endl;
+        return 1;
+    }
+    // killed by the signal passed on: die of it as well, as yac would have
+    if (forwarded_signal && status == 128 + forwarded_signal) {
+        signal(forwarded_signal, SIG_DFL);
+        raise(forwarded_signal);
+    }
+    return status;
+}
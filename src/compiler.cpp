@@ -0,0 +1,507 @@
+#include <llvm/IR/PassManager.h>
+#include <llvm/IR/IRPrintingPasses.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Analysis/ModuleSummaryAnalysis.h>
+#include <llvm/Analysis/ProfileSummaryInfo.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetRegistry.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+#include <llvm/Transforms/IPO/GlobalDCE.h>
+#include <llvm/Transforms/IPO/Internalize.h>
+#include <llvm/Transforms/IPO/SCCP.h>
+#include <llvm/Transforms/Instrumentation/PGOInstrumentation.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <iostream>
+#include "compiler.h"
+#include "cache.h"
+#include "interpreter.h"
+#include "profile.h"
+#include "trace.h"
+#include "ast/ast.h"
+#include "ast/context.h"
+
+// makes `unit' the current translation unit of this thread for the lifetime
+// of the object
+class YacCurrentTranslationUnit {
+public:
+    explicit YacCurrentTranslationUnit(YacTranslationUnit *unit)
+        : m_previous(YacTranslationUnit::current()) {
+        YacTranslationUnit::setCurrent(unit);
+    }
+    ~YacCurrentTranslationUnit() {
+        YacTranslationUnit::setCurrent(m_previous);
+    }
+private:
+    YacTranslationUnit *m_previous;
+};
+
+bool preprocessSource(const YacSourceBuffer &source, llvm::raw_ostream &out, const YacCompileOptions &options) {
+    YacTimeScope scope("Preprocess", options.name);
+    YacPreprocessor preprocessor(options.preprocessor, options.diagnostics ? *options.diagnostics : std::cerr);
+    return preprocessor.run(options.name, llvm::StringRef(source.data(), source.size()), out);
+}
+
+// Text without directives or line splices has nothing to expand, unless
+// macros are defined on the command line or it may name a predefined one
+// (`_LP64' or one starting with `__'). It is then scanned in place.
+static bool needsPreprocessing(const YacSourceBuffer &source, const YacCompileOptions &options) {
+    llvm::StringRef text(source.data(), source.size());
+    return !options.preprocessor.defines.empty() || text.find('#') != llvm::StringRef::npos
+           || text.find("__") != llvm::StringRef::npos || text.find("_LP64") != llvm::StringRef::npos
+           || text.find("\\\n") != llvm::StringRef::npos || text.find("\\\r\n") != llvm::StringRef::npos;
+}
+
+std::unique_ptr<llvm::Module> compileSource(YacSourceBuffer &source, llvm::LLVMContext &context,
+                                            const YacCompileOptions &options) {
+    YacTimeScope scope("Compile", options.name);
+    bool preprocess = options.preprocess && needsPreprocessing(source, options);
+    YacSourceBuffer expanded;
+    if (preprocess) {
+        YacSourceBufferStream out(expanded);
+        if (!preprocessSource(source, out, options))
+            return nullptr;
+        out.flush();
+        if (out.failed()) {
+            (options.diagnostics ? *options.diagnostics : std::cerr) << "yac: out of memory" << std::endl;
+            return nullptr;
+        }
+    }
+
+    YacTranslationUnit unit(context);
+    YacCurrentTranslationUnit current(&unit);
+    unit.sources().setName(options.name);
+    if (options.diagnostics)
+        unit.setDiagnostics(options.diagnostics);
+    try {
+        YacSemanticAnalyzer analyzer(unit.types());
+        if (options.streaming)
+            unit.setStreaming(&analyzer);
+        {
+            // generation of each declaration as parsed when streaming
+            YacTimeScope scope("Parse", options.name);
+            if (!parseSource(unit, preprocess ? expanded : source))
+                return nullptr;
+        }
+        YacTimeScope scope("Generate", options.name);
+        unit.root()->generate(analyzer);
+        if (unit.errors())
+            return nullptr;
+        return analyzer.takeModule();
+    } catch (YacSemanticError &err) {
+        unit.diagnostics() << "yac: " << err << std::endl;
+    } catch (YacSyntaxError &err) {
+        unit.diagnostics() << "yac: " << err << std::endl;
+    }
+    return nullptr;
+}
+
+std::unique_ptr<llvm::Module> loadSource(YacSourceBuffer &source, llvm::LLVMContext &context,
+                                         const YacCompileOptions &options) {
+    auto begin = reinterpret_cast<const unsigned char *>(source.data());
+    if (!llvm::isBitcode(begin, begin + source.size()))
+        return compileSource(source, context, options);
+    YacTimeScope scope("Read bitcode", options.name);
+    auto module = llvm::parseBitcodeFile(llvm::MemoryBufferRef(llvm::StringRef(source.data(), source.size()), options.name),
+                                         context);
+    if (!module) {
+        (options.diagnostics ? *options.diagnostics : std::cerr) << "yac: " << options.name << ": "
+                                                                 << llvm::toString(module.takeError()) << std::endl;
+        return nullptr;
+    }
+    return std::move(*module);
+}
+
+llvm::CodeGenOpt::Level codeGenOptLevel(YacOptimizationLevel level) {
+    switch (level) {
+        case YacOptimizationLevel::O0: return llvm::CodeGenOpt::None;
+        case YacOptimizationLevel::O1: return llvm::CodeGenOpt::Less;
+        case YacOptimizationLevel::O3: return llvm::CodeGenOpt::Aggressive;
+        default:                       return llvm::CodeGenOpt::Default;
+    }
+}
+
+static llvm::PassBuilder::OptimizationLevel passBuilderLevel(YacOptimizationLevel level) {
+    switch (level) {
+        case YacOptimizationLevel::O1: return llvm::PassBuilder::O1;
+        case YacOptimizationLevel::O2: return llvm::PassBuilder::O2;
+        case YacOptimizationLevel::O3: return llvm::PassBuilder::O3;
+        case YacOptimizationLevel::Os: return llvm::PassBuilder::Os;
+        default:                       return llvm::PassBuilder::O0;
+    }
+}
+
+// the CPU name and features options.cpu stands for
+static void targetCpu(const YacCompileOptions &options, bool jit, std::string &cpu, std::string &features) {
+    cpu = options.cpu.empty() ? (jit ? "native" : "generic") : options.cpu;
+    if (cpu != "native")
+        return;
+    cpu = llvm::sys::getHostCPUName().str();
+    llvm::StringMap<bool> host_features;
+    llvm::SubtargetFeatures list;
+    if (llvm::sys::getHostCPUFeatures(host_features))
+        for (auto &feature: host_features)
+            list.AddFeature(feature.first(), feature.second);
+    features = list.getString();
+}
+
+std::unique_ptr<llvm::TargetMachine> createTargetMachine(const YacCompileOptions &options, llvm::Module *module,
+                                                         std::string &error, bool jit) {
+    auto triple = jit ? llvm::sys::getProcessTriple() : llvm::sys::getDefaultTargetTriple();
+    auto target = llvm::TargetRegistry::lookupTarget(triple, error);
+    if (!target)
+        return nullptr;
+    std::string cpu, features;
+    targetCpu(options, jit, cpu, features);
+    // the JIT keeps the code and relocation models of the target, which
+    // account for code loaded anywhere in memory
+    llvm::Optional<llvm::Reloc::Model> relocation_model;
+    if (!jit)
+        relocation_model = options.relocation_model;
+    std::unique_ptr<llvm::TargetMachine> machine(target->createTargetMachine(
+            triple, cpu, features, llvm::TargetOptions(), relocation_model, llvm::None,
+            codeGenOptLevel(options.optimization), jit));
+    if (!machine) {
+        error = "cannot create target machine for `" + triple + '\'';
+        return nullptr;
+    }
+    if (module) {
+        module->setTargetTriple(triple);
+        module->setDataLayout(machine->createDataLayout());
+        // the optimizer asks the subtarget of each function, e.g. for the
+        // vector width
+        for (auto &function: *module) {
+            if (function.isDeclaration())
+                continue;
+            function.addFnAttr("target-cpu", cpu);
+            if (!features.empty())
+                function.addFnAttr("target-features", features);
+        }
+    }
+    return machine;
+}
+
+// Runs `Pass' in a time scope. The pipelines of PassBuilder are timed as a
+// whole, the pass manager of LLVM 7 having no hooks around each pass.
+template <typename Pass>
+class YacTimedPass : public llvm::PassInfoMixin<YacTimedPass<Pass>> {
+public:
+    YacTimedPass(const char *name, Pass pass)
+        : m_name(name), m_pass(std::move(pass)) {}
+    llvm::PreservedAnalyses run(llvm::Module &module, llvm::ModuleAnalysisManager &am) {
+        YacTimeScope scope(m_name);
+        return m_pass.run(module, am);
+    }
+private:
+    const char *m_name;
+    Pass m_pass;
+};
+
+template <typename Pass>
+static YacTimedPass<Pass> timedPass(const char *name, Pass pass) {
+    return YacTimedPass<Pass>(name, std::move(pass));
+}
+
+bool optimizeModule(llvm::Module &module, const YacCompileOptions &options) {
+    YacTimeScope scope("Optimize", module.getModuleIdentifier());
+    auto &diagnostics = options.diagnostics ? *options.diagnostics : std::cerr;
+    if (!options.profile_use.empty()) {
+        YacProfileData profile;
+        std::string error;
+        if (!readProfile(options.profile_use, profile, error)) {
+            diagnostics << "yac: " << error << std::endl;
+            return false;
+        }
+        YacTimeScope scope("Apply profile", options.profile_use);
+        applyProfile(module, profile, diagnostics);
+    }
+    if (options.whole_program) {
+        // the C library is only declared, hence left alone
+        YacTimeScope scope("Internalize");
+        llvm::internalizeModule(module, [](const llvm::GlobalValue &value) { return value.getName() == "main"; });
+    }
+    auto level = options.optimization;
+    if (level == YacOptimizationLevel::O0) {
+        if (options.whole_program) {
+            llvm::ModuleAnalysisManager module_am;
+            timedPass("GlobalDCE", llvm::GlobalDCEPass()).run(module, module_am);
+        }
+        return true;
+    }
+    // the cost models of the vectorizers and the inliner need the target,
+    // the generic ones are used without it
+    std::string error;
+    auto machine = createTargetMachine(options, &module, error);
+
+    llvm::PassBuilder builder(machine.get());
+    llvm::LoopAnalysisManager loop_am;
+    llvm::FunctionAnalysisManager function_am;
+    llvm::CGSCCAnalysisManager cgscc_am;
+    llvm::ModuleAnalysisManager module_am;
+    builder.registerModuleAnalyses(module_am);
+    builder.registerCGSCCAnalyses(cgscc_am);
+    builder.registerFunctionAnalyses(function_am);
+    builder.registerLoopAnalyses(loop_am);
+    builder.crossRegisterProxies(loop_am, function_am, cgscc_am, module_am);
+    llvm::ModulePassManager pm;
+    // the default pipeline only promotes indirect calls with a profile
+    // file of its own
+    if (!options.profile_use.empty())
+        pm.addPass(timedPass("PGOIndirectCallPromotion", llvm::PGOIndirectCallPromotion()));
+    // with internal linkage, IPSCCP propagates the constants callers pass
+    // and global DCE drops what nothing uses before the pipeline inlines
+    // across the former translation units
+    if (options.whole_program) {
+        pm.addPass(timedPass("IPSCCP", llvm::IPSCCPPass()));
+        pm.addPass(timedPass("GlobalDCE", llvm::GlobalDCEPass()));
+    }
+    pm.addPass(timedPass("Default pipeline", builder.buildPerModuleDefaultPipeline(passBuilderLevel(level))));
+    pm.run(module, module_am);
+    return true;
+}
+
+void printModule(llvm::Module &module, llvm::raw_ostream &out) {
+    llvm::PassManager<llvm::Module> pm;
+    llvm::AnalysisManager<llvm::Module> am;
+    pm.addPass(llvm::PrintModulePass(out));
+    pm.run(module, am);
+}
+
+bool emitModule(llvm::Module &module, llvm::raw_pwrite_stream &out, const YacCompileOptions &options,
+                std::ostream &diagnostics) {
+    if (options.output == YacOutputKind::IR) {
+        YacTimeScope scope("Print IR", module.getModuleIdentifier());
+        printModule(module, out);
+        return true;
+    }
+    if (options.output == YacOutputKind::Bitcode) {
+        YacTimeScope scope("Write bitcode", module.getModuleIdentifier());
+        if (!options.module_summary) {
+            llvm::WriteBitcodeToFile(module, out);
+            return true;
+        }
+        llvm::ProfileSummaryInfo profile(module);
+        auto index = llvm::buildModuleSummaryIndex(module, nullptr, &profile);
+        llvm::WriteBitcodeToFile(module, out, false, &index);
+        return true;
+    }
+    YacTimeScope scope("Codegen", module.getModuleIdentifier());
+    std::string error;
+    auto machine = createTargetMachine(options, &module, error);
+    if (!machine) {
+        diagnostics << "yac: " << error << std::endl;
+        return false;
+    }
+    llvm::legacy::PassManager pm;
+    auto type = options.output == YacOutputKind::Object ? llvm::TargetMachine::CGFT_ObjectFile
+                                                        : llvm::TargetMachine::CGFT_AssemblyFile;
+    if (machine->addPassesToEmitFile(pm, out, nullptr, type)) {
+        diagnostics << "yac: the target cannot emit this file type" << std::endl;
+        return false;
+    }
+    pm.run(module);
+    return true;
+}
+
+typedef int (*YacMainFunction)(int, const char **);
+
+static int reportJitError(llvm::Error error) {
+    std::cerr << "yac: " << llvm::toString(std::move(error)) << std::endl;
+    return 1;
+}
+
+// the target machine of the JIT, whose data layout `module' takes
+static llvm::Expected<std::unique_ptr<llvm::TargetMachine>> createJitTargetMachine(llvm::Module &module,
+                                                                                const YacCompileOptions &options) {
+    std::string error;
+    auto machine = createTargetMachine(options, &module, error, true);
+    if (!machine)
+        return llvm::make_error<llvm::StringError>(error, llvm::inconvertibleErrorCode());
+    return std::move(machine);
+}
+
+static llvm::Expected<std::unique_ptr<llvm::orc::LLLazyJIT>> createLazyJit(std::unique_ptr<llvm::TargetMachine> machine,
+                                                                        llvm::LLVMContext &context) {
+    auto layout = machine->createDataLayout();
+    auto jit = llvm::orc::LLLazyJIT::Create(llvm::make_unique<llvm::orc::ExecutionSession>(), std::move(machine),
+                                            layout, context);
+    if (!jit)
+        return jit.takeError();
+    // the C library comes from the process itself
+    auto generator = llvm::orc::DynamicLibraryFallbackGenerator::Load(nullptr, layout);
+    if (!generator)
+        return generator.takeError();
+    (*jit)->getMainVSO().setFallbackDefinitionGenerator(std::move(*generator));
+    return jit;
+}
+
+// Only `main' is looked up eagerly. Every other function is reached through
+// a stub that compiles it on its first call, so the startup cost follows the
+// code that actually runs rather than the size of the module.
+static int executeLazily(std::unique_ptr<llvm::Module> module, int argc, const char **argv,
+                         const YacCompileOptions &options) {
+    // the functions called later are compiled while `main' runs
+    YacTimeScope compile_scope("JIT compile", "main");
+    auto machine = createJitTargetMachine(*module, options);
+    if (!machine)
+        return reportJitError(machine.takeError());
+    auto jit = createLazyJit(std::move(*machine), module->getContext());
+    if (!jit)
+        return reportJitError(jit.takeError());
+    if (auto error = (*jit)->addLazyIRModule(std::move(module)))
+        return reportJitError(std::move(error));
+    if (auto error = (*jit)->runConstructors())
+        return reportJitError(std::move(error));
+    auto main = (*jit)->lookup("main");
+    if (!main)
+        return reportJitError(main.takeError());
+    compile_scope.end();
+    YacTimeScope run_scope("Run");
+    auto result = reinterpret_cast<YacMainFunction>(static_cast<uintptr_t>(main->getAddress()))(argc, argv);
+    if (auto error = (*jit)->runDestructors())
+        return reportJitError(std::move(error));
+    return result;
+}
+
+// The copy of `module' compiled for the promoted functions. Its global
+// variables are bound to the storage of the interpreter, so both tiers share
+// the data, and its functions are made external to be looked up by name.
+static llvm::Expected<std::unique_ptr<llvm::Module>> createTierModule(llvm::Module &module, YacInterpreter &interpreter,
+                                                                   llvm::orc::LLLazyJIT &jit,
+                                                                   llvm::ValueToValueMapTy &map) {
+    auto copy = llvm::CloneModule(module, map);
+    for (auto &global: module.globals()) {
+        if (global.isDeclaration())
+            continue;
+        auto bound = llvm::cast<llvm::GlobalVariable>(map[&global]);
+        if (!bound->hasName())
+            bound->setName("yac.global");
+        bound->setLinkage(llvm::GlobalValue::ExternalLinkage);
+        bound->setInitializer(nullptr);
+        bound->setComdat(nullptr);
+        // anywhere in the address space, out of reach of PC-relative accesses
+        bound->setDSOLocal(false);
+        auto address = reinterpret_cast<uintptr_t>(interpreter.globalAddress(&global));
+        if (auto error = jit.defineAbsolute(bound->getName(), llvm::JITEvaluatedSymbol(
+                static_cast<llvm::JITTargetAddress>(address), llvm::JITSymbolFlags::Exported)))
+            return std::move(error);
+    }
+    for (auto &function: *copy) {
+        if (function.isDeclaration())
+            continue;
+        if (!function.hasName())
+            function.setName("yac.function");
+        function.setLinkage(llvm::GlobalValue::ExternalLinkage);
+        function.setVisibility(llvm::GlobalValue::DefaultVisibility);
+    }
+    return std::move(copy);
+}
+
+// The data layout the x86-64 target gives every module on Linux, x86 being
+// the only target linked in. The interpreter lays the globals out with it
+// before any target machine exists.
+static const char g_host_data_layout[] = "e-m:e-i64:64-f80:128-n8:16:32:64-S128";
+
+// `main' starts in the interpreter at once. A function called or looping
+// often enough is compiled by a lazy JIT created on the first promotion, and
+// the interpreter calls the native code from then on. A module the
+// interpreter cannot handle goes to the lazy JIT whole.
+static int executeTiered(std::unique_ptr<llvm::Module> module, int argc, const char **argv,
+                         const YacCompileOptions &options) {
+    // the optimizer sets the layout of the target, as the JIT will
+    if (module->getDataLayout().isDefault())
+        module->setDataLayout(g_host_data_layout);
+    module->setTargetTriple(llvm::sys::getProcessTriple());
+    YacInterpreter interpreter(*module);
+    std::string reason;
+    if (!interpreter.prepare(reason))
+        return executeLazily(std::move(module), argc, argv, options);
+
+    std::unique_ptr<llvm::orc::LLLazyJIT> jit;
+    llvm::ValueToValueMapTy map;
+    bool available = true;
+    interpreter.setPromotion(options.tier_up_threshold, [&](llvm::Function *function) -> void * {
+        if (!available)
+            return nullptr;
+        YacTimeScope scope("Tier up", function->getName());
+        // the interpreter goes on if anything fails
+        auto fail = [&](llvm::Error error) -> void * {
+            reportJitError(std::move(error));
+            available = false;
+            return nullptr;
+        };
+        if (!jit) {
+            // a program that never gets hot never pays for the target machine
+            std::string error;
+            auto machine = createTargetMachine(options, nullptr, error, true);
+            if (!machine)
+                return fail(llvm::make_error<llvm::StringError>(error, llvm::inconvertibleErrorCode()));
+            // the globals are already laid out
+            if (machine->createDataLayout() != module->getDataLayout())
+                return fail(llvm::make_error<llvm::StringError>("the JIT does not share the data layout of the interpreter",
+                                                                llvm::inconvertibleErrorCode()));
+            auto created = createLazyJit(std::move(machine), module->getContext());
+            if (!created)
+                return fail(created.takeError());
+            jit = std::move(*created);
+            auto copy = createTierModule(*module, interpreter, *jit, map);
+            if (!copy)
+                return fail(copy.takeError());
+            if (auto error = jit->addLazyIRModule(std::move(*copy)))
+                return fail(std::move(error));
+        }
+        auto symbol = jit->lookup(map[function]->getName());
+        if (!symbol)
+            return fail(symbol.takeError());
+        return reinterpret_cast<void *>(static_cast<uintptr_t>(symbol->getAddress()));
+    });
+    YacTimeScope scope("Interpret");
+    return interpreter.run(argc, argv);
+}
+
+int executeModule(std::unique_ptr<llvm::Module> module, int argc, const char **argv, const YacCompileOptions &options) {
+    YacTimeScope scope("Execute", module->getModuleIdentifier());
+    if (options.jit == YacJitKind::Tiered)
+        return executeTiered(std::move(module), argc, argv, options);
+    if (options.jit == YacJitKind::Lazy && options.jit_cache.empty())
+        return executeLazily(std::move(module), argc, argv, options);
+    auto main = module->getFunction("main");
+    assert(main);
+    std::string error;
+    auto machine = createTargetMachine(options, module.get(), error, true);
+    if (!machine) {
+        std::cerr << "yac: " << error << std::endl;
+        return 1;
+    }
+    // anything changing the object besides the IR
+    std::string salt = std::string(LLVM_VERSION_STRING) + ' ' + machine->getTargetTriple().str() + ' '
+                       + machine->getTargetCPU().str() + ' ' + machine->getTargetFeatureString().str() + ' '
+                       + std::to_string(static_cast<int>(options.optimization));
+    YacObjectCache cache(options.jit_cache, salt, options.jit_cache_size);
+    std::unique_ptr<llvm::ExecutionEngine> engine(llvm::EngineBuilder(std::move(module))
+            .setOptLevel(codeGenOptLevel(options.optimization)).create(machine.release()));
+    if (!engine) {
+        std::cerr << "yac: failed to create execution engine" << std::endl;
+        return 1;
+    }
+    if (!options.jit_cache.empty())
+        engine->setObjectCache(&cache);
+    YacTimeScope compile_scope("JIT compile", "main");
+    engine->finalizeObject();
+    // before `main', which may never return
+    if (!options.jit_cache.empty())
+        cache.prune();
+    auto func = reinterpret_cast<YacMainFunction>(engine->getPointerToFunction(main));
+    compile_scope.end();
+    YacTimeScope run_scope("Run");
+    return func(argc, argv);
+}
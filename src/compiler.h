@@ -0,0 +1,127 @@
+#ifndef COMPILER_H_INCLUDE
+#define COMPILER_H_INCLUDE
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/CodeGen.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include <memory>
+#include <string>
+#include "syntax/source.h"
+#include "syntax/preprocessor.h"
+
+// Library interface of the compiler. Every call owns its own front-end state,
+// so different threads may compile at the same time as long as each of them
+// uses a different llvm::LLVMContext.
+
+enum class YacOptimizationLevel {
+    O0,
+    O1,
+    O2,
+    O3,
+    Os,
+};
+
+enum class YacOutputKind {
+    IR,         // textual LLVM IR
+    Bitcode,
+    Assembly,
+    Object,
+};
+
+enum class YacJitKind {
+    Lazy,   // ORC, every function is compiled on its first call
+    MCJIT,  // the whole module is compiled before `main' starts
+    Tiered, // interpreted first, hot functions are handed to the lazy JIT
+};
+
+struct YacCompileOptions {
+    // file name used in diagnostics until the first line marker
+    std::string name = "<stdin>";
+    // where to report errors, std::cerr if null
+    std::ostream *diagnostics = nullptr;
+    // generate every external declaration as soon as it is parsed and free
+    // its syntax tree, so that memory use is bounded by the largest function
+    bool streaming = false;
+    // run the built-in preprocessor first
+    bool preprocess = true;
+    YacPreprocessorOptions preprocessor;
+    // pipeline run by optimizeModule() before the module is written or executed
+    YacOptimizationLevel optimization = YacOptimizationLevel::O0;
+    // what emitModule() writes
+    YacOutputKind output = YacOutputKind::IR;
+    // bitcode carries a module summary, as ThinLTO expects
+    bool module_summary = false;
+    // target CPU of the code generator, "native" for the host's name and
+    // features; when empty, files are generic and the JIT targets the host
+    std::string cpu;
+    llvm::Reloc::Model relocation_model = llvm::Reloc::PIC_;
+    // threads generating an object written by writeModule(), each from a
+    // partition of the module
+    unsigned int codegen_threads = 1;
+    // used by executeModule()
+    YacJitKind jit = YacJitKind::Lazy;
+    // directory keeping the objects of executed modules across runs, none if
+    // empty; a cached module is compiled as a whole by MCJIT, since loading
+    // its object beats compiling it lazily
+    std::string jit_cache;
+    // in bytes, 0 for no limit
+    uint64_t jit_cache_size = 512 << 20;
+    // calls plus loop iterations after which the tiered JIT compiles a
+    // function
+    uint64_t tier_up_threshold = 1000;
+    // profile applied by optimizeModule(), none if empty
+    std::string profile_use;
+    // the module optimized is the whole program: everything but `main' is
+    // internalized first, so that unused code is dropped and the rest can be
+    // specialized and inlined across translation units
+    bool whole_program = false;
+};
+
+// Compiles one translation unit held in `source' into a module living in
+// `context'.
+// return nullptr on error
+std::unique_ptr<llvm::Module> compileSource(YacSourceBuffer &source, llvm::LLVMContext &context,
+                                            const YacCompileOptions &options = YacCompileOptions());
+
+// Like compileSource(), but `source' holding LLVM bitcode (as written by
+// --emit-bc) is read instead of compiled.
+// return nullptr on error
+std::unique_ptr<llvm::Module> loadSource(YacSourceBuffer &source, llvm::LLVMContext &context,
+                                         const YacCompileOptions &options = YacCompileOptions());
+
+// Writes the preprocessed text of `source' to `out'.
+// return false on error
+bool preprocessSource(const YacSourceBuffer &source, llvm::raw_ostream &out,
+                      const YacCompileOptions &options = YacCompileOptions());
+
+// the code generator level matching `level'
+llvm::CodeGenOpt::Level codeGenOptLevel(YacOptimizationLevel level);
+// A TargetMachine for the host triple configured by `options', also giving
+// `module' (if any) its triple, data layout and the CPU attributes of its
+// functions. A machine for the JIT targets the process and the host CPU by
+// default.
+// return nullptr and set `error' if the target is not available
+std::unique_ptr<llvm::TargetMachine> createTargetMachine(const YacCompileOptions &options, llvm::Module *module,
+                                                         std::string &error, bool jit = false);
+
+// Runs the standard LLVM pipeline of options.optimization (SROA, inlining,
+// GVN, LICM, the loop and SLP vectorizers...) on `module', tuned for the
+// target. Nothing is done at -O0 but annotating the module with
+// options.profile_use.
+// return false if the profile cannot be read
+bool optimizeModule(llvm::Module &module, const YacCompileOptions &options);
+
+void printModule(llvm::Module &module, llvm::raw_ostream &out);
+// Writes `module' to `out' as options.output, assembly and objects are
+// generated in process.
+// return false on error
+bool emitModule(llvm::Module &module, llvm::raw_pwrite_stream &out, const YacCompileOptions &options,
+                std::ostream &diagnostics);
+// Runs `main' of `module' with the JIT of options.jit and returns its exit
+// code. The context of `module' must outlive the call.
+int executeModule(std::unique_ptr<llvm::Module> module, int argc, const char **argv,
+                  const YacCompileOptions &options = YacCompileOptions());
+
+#endif
@@ -0,0 +1,257 @@
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/SplitModule.h>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include "driver.h"
+#include "compiler.h"
+#include "trace.h"
+
+void parallelFor(unsigned int jobs, size_t count, const std::function<void(size_t)> &body)
+{
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i; (i = next++) < count;)
+            body(i);
+    };
+    std::vector<std::thread> threads;
+    auto thread_count = std::min<size_t>(std::max(jobs, 1u), count);
+    for (size_t i = 1; i < thread_count; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &thread: threads)
+        thread.join();
+}
+
+static bool openInput(YacSourceBuffer &source, const std::string &input, YacCompileOptions &options)
+{
+    if (input == "-") {
+        options.name = "<stdin>";
+        return source.openStream(stdin);
+    }
+    options.name = input;
+    return source.openFile(input.c_str());
+}
+
+// result of compiling one input or partition on a worker thread
+struct YacCompileResult {
+    bool success = false;
+    std::string diagnostics;
+    llvm::SmallVector<char, 0> bitcode;
+};
+
+static void flushDiagnostics(const std::vector<YacCompileResult> &results)
+{
+    for (auto &result: results)
+        std::cerr << result.diagnostics;
+    std::cerr.flush();
+}
+
+// Splits `module' as SplitModule() does, keeping the functions and globals
+// depending on each other together, and generates the object of every
+// partition on a thread of its own. The partitions cross over to the contexts
+// of the threads as bitcode. Local symbols stay local, along with all their
+// users in one partition, so the merged object exports what the module does.
+static bool writePartitionedObject(llvm::Module &module, const std::string &output, const YacCompileOptions &options,
+                                   std::ostream &diagnostics)
+{
+    auto linker = llvm::sys::findProgramByName("ld");
+    if (!linker) {
+        diagnostics << "yac: cannot find `ld' to merge the objects of --codegen-threads" << std::endl;
+        return false;
+    }
+    std::vector<YacCompileResult> results;
+    YacTimeScope split_scope("Split module", output);
+    llvm::SplitModule(llvm::CloneModule(module), options.codegen_threads, [&](std::unique_ptr<llvm::Module> partition) {
+        results.emplace_back();
+        llvm::raw_svector_ostream out(results.back().bitcode);
+        llvm::WriteBitcodeToFile(*partition, out);
+    }, true);
+    split_scope.end();
+    std::vector<std::string> objects(results.size());
+    parallelFor(options.codegen_threads, results.size(), [&](size_t i) {
+        std::ostringstream diagnostics;
+        auto &bitcode = results[i].bitcode;
+        llvm::LLVMContext context;
+        auto partition = llvm::parseBitcodeFile(llvm::MemoryBufferRef(llvm::StringRef(bitcode.data(), bitcode.size()),
+                                                                      output), context);
+        int fd;
+        llvm::SmallString<128> path;
+        if (!partition)
+            diagnostics << "yac: " << llvm::toString(partition.takeError()) << std::endl;
+        else if (llvm::sys::fs::createTemporaryFile("yac", "o", fd, path))
+            diagnostics << "yac: cannot create a temporary file" << std::endl;
+        else {
+            objects[i] = path.str().str();
+            llvm::raw_fd_ostream out(fd, true);
+            results[i].success = emitModule(**partition, out, options, diagnostics);
+        }
+        results[i].diagnostics = diagnostics.str();
+    });
+    bool success = true;
+    for (auto &result: results) {
+        diagnostics << result.diagnostics;
+        success = success && result.success;
+    }
+
+    // a relocatable link into one object, through a temporary file for the
+    // standard output
+    llvm::SmallString<128> merged(output);
+    if (success && output == "-" && llvm::sys::fs::createTemporaryFile("yac", "o", merged)) {
+        diagnostics << "yac: cannot create a temporary file" << std::endl;
+        success = false;
+    }
+    if (success) {
+        YacTimeScope scope("Merge objects", output);
+        std::vector<llvm::StringRef> args{*linker, "-r", "-o", merged};
+        args.insert(args.end(), objects.begin(), objects.end());
+        std::string error;
+        if (llvm::sys::ExecuteAndWait(*linker, args, llvm::None, {}, 0, 0, &error) != 0) {
+            diagnostics << "yac: cannot merge the objects into `" << output << "'";
+            if (!error.empty())
+                diagnostics << ": " << error;
+            diagnostics << std::endl;
+            success = false;
+        }
+    }
+    if (success && output == "-") {
+        auto buffer = llvm::MemoryBuffer::getFile(merged);
+        if (buffer)
+            llvm::outs() << (*buffer)->getBuffer();
+        success = static_cast<bool>(buffer);
+    }
+    if (output == "-" && merged != output)
+        llvm::sys::fs::remove(merged);
+    for (auto &object: objects)
+        if (!object.empty())
+            llvm::sys::fs::remove(object);
+    return success;
+}
+
+bool writeModule(llvm::Module &module, const std::string &output, const YacCompileOptions &options,
+                 std::ostream &diagnostics)
+{
+    // assembly of several partitions cannot be put together, it comes from
+    // one thread
+    if (options.output == YacOutputKind::Object && options.codegen_threads > 1)
+        return writePartitionedObject(module, output, options, diagnostics);
+    if (output == "-") {
+        // the object writer seeks backwards, which pipes cannot do
+        llvm::buffer_ostream buffer(llvm::outs());
+        return emitModule(module, buffer, options, diagnostics);
+    }
+    std::error_code err;
+    bool binary = options.output == YacOutputKind::Object || options.output == YacOutputKind::Bitcode;
+    llvm::raw_fd_ostream out(output, err, binary ? llvm::sys::fs::F_None : llvm::sys::fs::F_Text);
+    if (err) {
+        diagnostics << "yac: cannot open output file `" << output << '\'' << std::endl;
+        return false;
+    }
+    return emitModule(module, out, options, diagnostics);
+}
+
+bool compileToFiles(const std::vector<std::string> &inputs, const std::vector<std::string> &outputs, unsigned int jobs,
+                    const YacCompileOptions &base_options)
+{
+    assert(inputs.size() == outputs.size());
+    std::vector<YacCompileResult> results(inputs.size());
+    parallelFor(jobs, inputs.size(), [&](size_t i) {
+        std::ostringstream diagnostics;
+        YacSourceBuffer source;
+        YacCompileOptions options = base_options;
+        options.diagnostics = &diagnostics;
+        if (!openInput(source, inputs[i], options))
+            diagnostics << "yac: cannot open input file `" << inputs[i] << '\'' << std::endl;
+        else {
+            llvm::LLVMContext context;
+            auto module = loadSource(source, context, options);
+            results[i].success = module && optimizeModule(*module, options)
+                                 && writeModule(*module, outputs[i], options, diagnostics);
+        }
+        results[i].diagnostics = diagnostics.str();
+    });
+    flushDiagnostics(results);
+    return std::all_of(results.begin(), results.end(), [](const YacCompileResult &result) { return result.success; });
+}
+
+std::unique_ptr<llvm::Module> compileAndLink(const std::vector<std::string> &inputs, unsigned int jobs,
+                                             const YacCompileOptions &base_options, llvm::LLVMContext &context)
+{
+    if (inputs.size() == 1) {
+        // nothing to link, compile straight into `context'
+        YacSourceBuffer source;
+        YacCompileOptions options = base_options;
+        if (!openInput(source, inputs[0], options)) {
+            std::cerr << "yac: cannot open input file `" << inputs[0] << '\'' << std::endl;
+            return nullptr;
+        }
+        return loadSource(source, context, options);
+    }
+    // Modules cannot move between contexts, so every worker hands its module
+    // over as bitcode.
+    std::vector<YacCompileResult> results(inputs.size());
+    parallelFor(jobs, inputs.size(), [&](size_t i) {
+        std::ostringstream diagnostics;
+        YacSourceBuffer source;
+        YacCompileOptions options = base_options;
+        options.diagnostics = &diagnostics;
+        if (!openInput(source, inputs[i], options))
+            diagnostics << "yac: cannot open input file `" << inputs[i] << '\'' << std::endl;
+        else {
+            llvm::LLVMContext worker_context;
+            auto module = loadSource(source, worker_context, options);
+            if (module) {
+                llvm::raw_svector_ostream out(results[i].bitcode);
+                llvm::WriteBitcodeToFile(*module, out);
+                results[i].success = true;
+            }
+        }
+        results[i].diagnostics = diagnostics.str();
+    });
+    flushDiagnostics(results);
+    std::unique_ptr<llvm::Module> linked;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        if (!results[i].success)
+            return nullptr;
+        auto &bitcode = results[i].bitcode;
+        auto module = llvm::parseBitcodeFile(llvm::MemoryBufferRef(llvm::StringRef(bitcode.data(), bitcode.size()), inputs[i]),
+                                             context);
+        if (!module) {
+            llvm::logAllUnhandledErrors(module.takeError(), llvm::errs(), "yac: ");
+            return nullptr;
+        }
+        YacTimeScope scope("Link", inputs[i]);
+        if (!linked)
+            linked = std::move(*module);
+        else if (llvm::Linker::linkModules(*linked, std::move(*module))) {
+            std::cerr << "yac: cannot link `" << inputs[i] << '\'' << std::endl;
+            return nullptr;
+        }
+    }
+    return linked;
+}
+
+bool preprocessToStream(const std::vector<std::string> &inputs, const YacCompileOptions &base_options,
+                        llvm::raw_ostream &out)
+{
+    bool success = true;
+    for (auto &input: inputs) {
+        YacSourceBuffer source;
+        YacCompileOptions options = base_options;
+        if (!openInput(source, input, options)) {
+            std::cerr << "yac: cannot open input file `" << input << '\'' << std::endl;
+            success = false;
+        } else if (!preprocessSource(source, out, options))
+            success = false;
+    }
+    return success;
+}
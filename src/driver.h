@@ -0,0 +1,47 @@
+#ifndef DRIVER_H_INCLUDE
+#define DRIVER_H_INCLUDE
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "compiler.h"
+
+// Compilation of several translation units on a pool of threads. Every
+// translation unit gets an LLVMContext and a YacSemanticAnalyzer of its own.
+// Diagnostics are buffered per file and written to std::cerr in the order of
+// the inputs, so neither they nor the outputs depend on thread scheduling.
+// An input holding LLVM bitcode is read rather than compiled.
+// An input named "-" is the standard input, an output named "-" is the
+// standard output. `options' applies to every input, its name and
+// diagnostics are filled in per input.
+
+// Runs `body(i)' for every i in [0, count) on up to `jobs' threads.
+void parallelFor(unsigned int jobs, size_t count, const std::function<void(size_t)> &body);
+
+// Writes `module' to the file `output' as options.output. With several
+// options.codegen_threads, an object is generated from as many partitions of
+// the module in parallel and their objects are merged by `ld -r'.
+// return false on error
+bool writeModule(llvm::Module &module, const std::string &output, const YacCompileOptions &options,
+                 std::ostream &diagnostics);
+
+// Writes the module of inputs[i] to outputs[i].
+// return false if any of them fails
+bool compileToFiles(const std::vector<std::string> &inputs, const std::vector<std::string> &outputs, unsigned int jobs,
+                    const YacCompileOptions &options);
+
+// Links the modules of all the inputs, in order, into one module living in
+// `context'.
+// return nullptr on error
+std::unique_ptr<llvm::Module> compileAndLink(const std::vector<std::string> &inputs, unsigned int jobs,
+                                             const YacCompileOptions &options, llvm::LLVMContext &context);
+
+// Writes the preprocessed text of all the inputs, in order, to `out'.
+// return false if any of them fails
+bool preprocessToStream(const std::vector<std::string> &inputs, const YacCompileOptions &options,
+                        llvm::raw_ostream &out);
+
+#endif
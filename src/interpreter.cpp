@@ -0,0 +1,886 @@
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/GetElementPtrTypeIterator.h>
+#include <llvm/IR/InlineAsm.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/Operator.h>
+#include <llvm/Support/DynamicLibrary.h>
+#include <llvm/Support/MathExtras.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#ifdef YAC_HAVE_FFI
+#include <ffi.h>
+#endif
+#include "interpreter.h"
+
+enum YacOpcode: uint16_t {
+    Mov,
+    Mask,           // truncation to `width' bits
+    SExt,           // from `flag' to `width' bits
+    Add, Sub, Mul, UDiv, SDiv, URem, SRem, Shl, LShr, AShr, And, Or, Xor,
+    FAdd, FSub, FMul, FDiv, FRem,
+    ICmp, FCmp,     // the predicate is `flag'
+    FPToSI, FPToUI, SIToFP, UIToFP, FPExt, FPTrunc,
+    Select,         // dst = a ? b : register imm
+    Load,           // `width' bytes at a
+    Store,          // `width' bytes of a at b
+    FrameAddress,   // dst = frame + imm
+    AddScaled,      // dst = a + sext(b from `flag' bits) * imm
+    AddOffset,      // dst = a + imm
+    Jump,           // to imm
+    Branch,         // to imm if a, else to b
+    Return,         // a if `flag'
+    Call,           // call site imm
+    Unreachable,
+};
+
+// Operands are registers unless noted. `width' is the number of bits of
+// integer results, 32 or 64 for floating ones.
+struct YacBytecode {
+    YacOpcode opcode;
+    uint8_t width;
+    uint8_t flag;
+    uint32_t dst, a, b;
+    uint64_t imm;
+};
+
+struct YacInterpreter::Function {
+    llvm::Function *function;
+    std::vector<YacBytecode> code;
+    // preloaded into the registers [constant_base, register_count)
+    std::vector<YacSlot> constants;
+    uint32_t constant_base = 0, register_count = 0;
+    uint64_t frame_size = 0;
+    uint64_t count = 0;         // calls and loop iterations
+    bool promoted = false;      // the promotion was tried
+    void *native = nullptr;
+};
+
+struct YacInterpreter::CallSite {
+    Function *callee = nullptr;     // interpreted
+    void *address = nullptr;        // native
+    uint32_t callee_register = 0;   // a native pointer if both are null
+    uint32_t result = 0;
+    uint64_t result_mask = 0;       // for integer results
+    std::vector<uint32_t> args;
+    bool native_callable = false;   // `cif' is ready
+#ifdef YAC_HAVE_FFI
+    std::vector<ffi_type *> arg_types;
+    ffi_cif cif;
+#endif
+};
+
+static const size_t RegisterStackSize = 1 << 20;
+static const size_t FrameStackSize = 8 << 20;
+
+static uint64_t mask(unsigned int bits) {
+    return bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << bits) - 1;
+}
+
+static int64_t signExtend(uint64_t value, unsigned int bits) {
+    return bits >= 64 ? static_cast<int64_t>(value) : static_cast<int64_t>(value << (64 - bits)) >> (64 - bits);
+}
+
+static bool compareIntegers(unsigned int predicate, uint64_t left, uint64_t right, unsigned int bits) {
+    switch (predicate) {
+        case llvm::CmpInst::ICMP_EQ:  return left == right;
+        case llvm::CmpInst::ICMP_NE:  return left != right;
+        case llvm::CmpInst::ICMP_UGT: return left > right;
+        case llvm::CmpInst::ICMP_UGE: return left >= right;
+        case llvm::CmpInst::ICMP_ULT: return left < right;
+        case llvm::CmpInst::ICMP_ULE: return left <= right;
+        case llvm::CmpInst::ICMP_SGT: return signExtend(left, bits) > signExtend(right, bits);
+        case llvm::CmpInst::ICMP_SGE: return signExtend(left, bits) >= signExtend(right, bits);
+        case llvm::CmpInst::ICMP_SLT: return signExtend(left, bits) < signExtend(right, bits);
+        default:                      return signExtend(left, bits) <= signExtend(right, bits);
+    }
+}
+
+template <typename T>
+static bool compareFloating(unsigned int predicate, T left, T right) {
+    bool unordered = std::isnan(left) || std::isnan(right);
+    switch (predicate) {
+        case llvm::CmpInst::FCMP_FALSE: return false;
+        case llvm::CmpInst::FCMP_OEQ:   return !unordered && left == right;
+        case llvm::CmpInst::FCMP_OGT:   return !unordered && left > right;
+        case llvm::CmpInst::FCMP_OGE:   return !unordered && left >= right;
+        case llvm::CmpInst::FCMP_OLT:   return !unordered && left < right;
+        case llvm::CmpInst::FCMP_OLE:   return !unordered && left <= right;
+        case llvm::CmpInst::FCMP_ONE:   return !unordered && left != right;
+        case llvm::CmpInst::FCMP_ORD:   return !unordered;
+        case llvm::CmpInst::FCMP_UNO:   return unordered;
+        case llvm::CmpInst::FCMP_UEQ:   return unordered || left == right;
+        case llvm::CmpInst::FCMP_UGT:   return unordered || left > right;
+        case llvm::CmpInst::FCMP_UGE:   return unordered || left >= right;
+        case llvm::CmpInst::FCMP_ULT:   return unordered || left < right;
+        case llvm::CmpInst::FCMP_ULE:   return unordered || left <= right;
+        case llvm::CmpInst::FCMP_UNE:   return unordered || left != right;
+        default:                        return true;
+    }
+}
+
+// registers hold integers up to 64 bits, float, double and pointers
+static bool isSupportedType(llvm::Type *type) {
+    if (type->isIntegerTy())
+        return type->getIntegerBitWidth() <= 64;
+    return type->isVoidTy() || type->isFloatTy() || type->isDoubleTy() || type->isPointerTy();
+}
+
+static unsigned int bitsOf(llvm::Type *type) {
+    if (type->isPointerTy())
+        return 64;
+    if (type->isFloatTy())
+        return 32;
+    if (type->isDoubleTy())
+        return 64;
+    return type->getIntegerBitWidth();
+}
+
+#ifdef YAC_HAVE_FFI
+static ffi_type *ffiType(llvm::Type *type) {
+    if (type->isVoidTy())
+        return &ffi_type_void;
+    if (type->isFloatTy())
+        return &ffi_type_float;
+    if (type->isDoubleTy())
+        return &ffi_type_double;
+    if (type->isPointerTy())
+        return &ffi_type_pointer;
+    if (!type->isIntegerTy())
+        return nullptr;
+    switch (type->getIntegerBitWidth()) {
+        case 1:
+        case 8:  return &ffi_type_uint8;
+        case 16: return &ffi_type_uint16;
+        case 32: return &ffi_type_uint32;
+        case 64: return &ffi_type_uint64;
+        default: return nullptr;
+    }
+}
+#endif
+
+// the libffi description of the call `call' with its actual arguments
+static bool prepareNativeCall(YacInterpreter::CallSite &site, llvm::CallInst *call) {
+#ifdef YAC_HAVE_FFI
+    for (auto &arg: call->arg_operands()) {
+        auto type = ffiType(arg->getType());
+        if (!type)
+            return false;
+        site.arg_types.push_back(type);
+    }
+    auto result_type = ffiType(call->getType());
+    if (!result_type)
+        return false;
+    auto function_type = call->getFunctionType();
+    auto count = static_cast<unsigned int>(site.arg_types.size());
+    ffi_status status;
+    if (function_type->isVarArg())
+        status = ffi_prep_cif_var(&site.cif, FFI_DEFAULT_ABI, function_type->getNumParams(), count, result_type,
+                                  site.arg_types.data());
+    else
+        status = ffi_prep_cif(&site.cif, FFI_DEFAULT_ABI, count, result_type, site.arg_types.data());
+    site.native_callable = status == FFI_OK;
+    return site.native_callable;
+#else
+    return false;
+#endif
+}
+
+
+YacInterpreter::YacInterpreter(llvm::Module &module)
+    : m_module(module), m_layout(module.getDataLayout()) {}
+
+YacInterpreter::~YacInterpreter() = default;
+
+void *YacInterpreter::symbol(llvm::StringRef name) {
+    return llvm::sys::DynamicLibrary::SearchForAddressOfSymbol(name.str());
+}
+
+bool YacInterpreter::evaluate(const llvm::Constant *constant, YacSlot &slot) {
+    slot.i = 0;
+    if (auto integer = llvm::dyn_cast<llvm::ConstantInt>(constant)) {
+        if (integer->getBitWidth() > 64)
+            return false;
+        slot.i = integer->getZExtValue();
+        return true;
+    }
+    if (auto floating = llvm::dyn_cast<llvm::ConstantFP>(constant)) {
+        if (floating->getType()->isFloatTy())
+            slot.f = floating->getValueAPF().convertToFloat();
+        else if (floating->getType()->isDoubleTy())
+            slot.d = floating->getValueAPF().convertToDouble();
+        else
+            return false;
+        return true;
+    }
+    if (llvm::isa<llvm::ConstantPointerNull>(constant) || llvm::isa<llvm::UndefValue>(constant))
+        return true;
+    if (auto global = llvm::dyn_cast<llvm::GlobalVariable>(constant)) {
+        slot.p = m_globals.lookup(global);
+        return slot.p != nullptr;
+    }
+    if (auto function = llvm::dyn_cast<llvm::Function>(constant)) {
+        // defined functions never are values, see prepare()
+        if (!function->isDeclaration())
+            return false;
+        slot.p = symbol(function->getName());
+        return slot.p != nullptr;
+    }
+    auto expression = llvm::dyn_cast<llvm::ConstantExpr>(constant);
+    if (!expression)
+        return false;
+    switch (expression->getOpcode()) {
+        case llvm::Instruction::GetElementPtr: {
+            llvm::APInt offset(m_layout.getPointerTypeSizeInBits(expression->getType()), 0);
+            if (!llvm::cast<llvm::GEPOperator>(expression)->accumulateConstantOffset(m_layout, offset)
+                    || !evaluate(expression->getOperand(0), slot))
+                return false;
+            slot.i += offset.getSExtValue();
+            return true;
+        }
+        case llvm::Instruction::BitCast:
+        case llvm::Instruction::IntToPtr:
+        case llvm::Instruction::PtrToInt:
+        case llvm::Instruction::ZExt:
+        case llvm::Instruction::SExt:
+        case llvm::Instruction::Trunc: {
+            auto operand = expression->getOperand(0);
+            if (!isSupportedType(operand->getType()) || !evaluate(operand, slot))
+                return false;
+            if (expression->getOpcode() == llvm::Instruction::SExt)
+                slot.i = static_cast<uint64_t>(signExtend(slot.i, bitsOf(operand->getType())));
+            if (expression->getType()->isIntegerTy())
+                slot.i &= mask(expression->getType()->getIntegerBitWidth());
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+// `address' is zero filled
+bool YacInterpreter::initialize(char *address, const llvm::Constant *constant) {
+    if (constant->isNullValue() || llvm::isa<llvm::UndefValue>(constant))
+        return true;
+    if (auto data = llvm::dyn_cast<llvm::ConstantDataSequential>(constant)) {
+        auto raw = data->getRawDataValues();
+        std::memcpy(address, raw.data(), raw.size());
+        return true;
+    }
+    if (auto array = llvm::dyn_cast<llvm::ConstantArray>(constant)) {
+        auto size = m_layout.getTypeAllocSize(array->getType()->getElementType());
+        for (unsigned int i = 0; i < array->getNumOperands(); ++i)
+            if (!initialize(address + i * size, array->getOperand(i)))
+                return false;
+        return true;
+    }
+    if (auto structure = llvm::dyn_cast<llvm::ConstantStruct>(constant)) {
+        auto layout = m_layout.getStructLayout(structure->getType());
+        for (unsigned int i = 0; i < structure->getNumOperands(); ++i)
+            if (!initialize(address + layout->getElementOffset(i), structure->getOperand(i)))
+                return false;
+        return true;
+    }
+    YacSlot slot;
+    if (!isSupportedType(constant->getType()) || !evaluate(constant, slot))
+        return false;
+    std::memcpy(address, &slot, m_layout.getTypeStoreSize(constant->getType()));
+    return true;
+}
+
+bool YacInterpreter::prepare(std::string &error) {
+    // symbols of the process itself, for the C library
+    llvm::sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
+    for (auto &global: m_module.globals()) {
+        void *address;
+        if (global.isDeclaration()) {
+            address = symbol(global.getName());
+            if (!address) {
+                error = "undefined symbol `" + global.getName().str() + '\'';
+                return false;
+            }
+        } else {
+            auto size = m_layout.getTypeAllocSize(global.getValueType());
+            m_storage.emplace_back(new char[size ? size : 1]());
+            address = m_storage.back().get();
+        }
+        m_globals[&global] = address;
+    }
+    // initializers may refer to any global
+    for (auto &global: m_module.globals())
+        if (global.hasInitializer()
+                && !initialize(static_cast<char *>(m_globals[&global]), global.getInitializer())) {
+            error = "unsupported initializer of `" + global.getName().str() + '\'';
+            return false;
+        }
+
+    for (auto &function: m_module) {
+        if (function.isDeclaration())
+            continue;
+        // native code could not call it back
+        if (function.hasAddressTaken()) {
+            error = "the address of `" + function.getName().str() + "' is taken";
+            return false;
+        }
+        m_function_list.emplace_back(new Function);
+        m_function_list.back()->function = &function;
+        m_functions[&function] = m_function_list.back().get();
+    }
+    for (auto &function: m_function_list)
+        if (!lower(*function, error))
+            return false;
+    m_registers.reset(new YacSlot[RegisterStackSize]);
+    m_stack.reset(new char[FrameStackSize]);
+    return true;
+}
+
+bool YacInterpreter::lower(Function &record, std::string &error) {
+    auto &function = *record.function;
+    auto &code = record.code;
+    llvm::DenseMap<const llvm::Value *, uint32_t> registers;
+    uint32_t next = 0;
+    for (auto &arg: function.args())
+        registers[&arg] = next++;
+    unsigned int max_phis = 0;
+    for (auto &block: function) {
+        unsigned int phis = 0;
+        for (auto &instruction: block) {
+            if (llvm::isa<llvm::PHINode>(instruction))
+                ++phis;
+            if (!instruction.getType()->isVoidTy())
+                registers[&instruction] = next++;
+        }
+        max_phis = std::max(max_phis, phis);
+    }
+    // the incoming values of phis are copied here first
+    uint32_t phi_temporaries = next;
+    record.constant_base = next + max_phis;
+
+    bool failed = false;
+    auto fail = [&](const std::string &message) {
+        if (!failed)
+            error = message + " in `" + function.getName().str() + '\'';
+        failed = true;
+    };
+    auto use = [&](const llvm::Value *value) -> uint32_t {
+        if (!isSupportedType(value->getType())) {
+            fail("unsupported type");
+            return 0;
+        }
+        auto found = registers.find(value);
+        if (found != registers.end())
+            return found->second;
+        YacSlot slot;
+        auto constant = llvm::dyn_cast<llvm::Constant>(value);
+        if (!constant || !evaluate(constant, slot)) {
+            fail("unsupported constant");
+            return 0;
+        }
+        auto index = record.constant_base + static_cast<uint32_t>(record.constants.size());
+        record.constants.push_back(slot);
+        registers[value] = index;
+        return index;
+    };
+    auto emit = [&](YacOpcode opcode, unsigned int width, unsigned int flag, uint32_t dst, uint32_t a, uint32_t b,
+                    uint64_t imm) {
+        code.push_back(YacBytecode{opcode, static_cast<uint8_t>(width), static_cast<uint8_t>(flag), dst, a, b, imm});
+    };
+
+    // branch targets are patched once every block has been placed
+    struct Fixup {
+        size_t index;
+        bool false_target;
+        const llvm::BasicBlock *block;
+    };
+    std::vector<Fixup> fixups;
+    llvm::DenseMap<const llvm::BasicBlock *, uint64_t> starts;
+    auto moves = [&](const llvm::BasicBlock *from, const llvm::BasicBlock *to) {
+        std::vector<std::pair<uint32_t, uint32_t>> pairs;
+        for (auto &instruction: *to) {
+            auto phi = llvm::dyn_cast<llvm::PHINode>(&instruction);
+            if (!phi)
+                break;
+            pairs.emplace_back(registers[phi], use(phi->getIncomingValueForBlock(from)));
+        }
+        // phis read their operands before any of them is written
+        if (pairs.size() == 1)
+            emit(Mov, 0, 0, pairs[0].first, pairs[0].second, 0, 0);
+        else if (pairs.size() > 1) {
+            for (uint32_t i = 0; i < pairs.size(); ++i)
+                emit(Mov, 0, 0, phi_temporaries + i, pairs[i].second, 0, 0);
+            for (uint32_t i = 0; i < pairs.size(); ++i)
+                emit(Mov, 0, 0, pairs[i].first, phi_temporaries + i, 0, 0);
+        }
+    };
+    auto jump = [&](const llvm::BasicBlock *from, const llvm::BasicBlock *to) {
+        moves(from, to);
+        fixups.push_back(Fixup{code.size(), false, to});
+        emit(Jump, 0, 0, 0, 0, 0, 0);
+    };
+
+    for (auto &block: function) {
+        starts[&block] = code.size();
+        for (auto &instruction: block) {
+            if (failed)
+                return false;
+            auto type = instruction.getType();
+            if (!isSupportedType(type)) {
+                fail("unsupported type");
+                break;
+            }
+            uint32_t dst = type->isVoidTy() ? 0 : registers[&instruction];
+            auto opcode = instruction.getOpcode();
+            switch (opcode) {
+                case llvm::Instruction::PHI:
+                    // moved on the incoming edges
+                    break;
+                case llvm::Instruction::Alloca: {
+                    auto alloca = llvm::cast<llvm::AllocaInst>(&instruction);
+                    auto count = llvm::dyn_cast<llvm::ConstantInt>(alloca->getArraySize());
+                    if (&block != &function.getEntryBlock() || !count || alloca->getAlignment() > 16) {
+                        fail("dynamic alloca");
+                        break;
+                    }
+                    auto size = m_layout.getTypeAllocSize(alloca->getAllocatedType()) * count->getZExtValue();
+                    record.frame_size = llvm::alignTo(record.frame_size, std::max<uint64_t>(alloca->getAlignment(), 1));
+                    emit(FrameAddress, 0, 0, dst, 0, 0, record.frame_size);
+                    record.frame_size += std::max<uint64_t>(size, 1);
+                    break;
+                }
+                case llvm::Instruction::Load: {
+                    auto load = llvm::cast<llvm::LoadInst>(&instruction);
+                    if (load->isAtomic()) {
+                        fail("atomic load");
+                        break;
+                    }
+                    emit(Load, m_layout.getTypeStoreSize(type), 0, dst, use(load->getPointerOperand()), 0, 0);
+                    break;
+                }
+                case llvm::Instruction::Store: {
+                    auto store = llvm::cast<llvm::StoreInst>(&instruction);
+                    auto value = store->getValueOperand();
+                    if (store->isAtomic()) {
+                        fail("atomic store");
+                        break;
+                    }
+                    emit(Store, m_layout.getTypeStoreSize(value->getType()), 0, 0, use(value),
+                         use(store->getPointerOperand()), 0);
+                    break;
+                }
+                case llvm::Instruction::GetElementPtr: {
+                    auto gep = llvm::cast<llvm::GetElementPtrInst>(&instruction);
+                    uint32_t current = use(gep->getPointerOperand());
+                    int64_t offset = 0;
+                    for (auto iter = llvm::gep_type_begin(gep), end = llvm::gep_type_end(gep); iter != end; ++iter) {
+                        auto index = iter.getOperand();
+                        auto constant = llvm::dyn_cast<llvm::ConstantInt>(index);
+                        if (auto structure = iter.getStructTypeOrNull()) {
+                            offset += m_layout.getStructLayout(structure)->getElementOffset(constant->getZExtValue());
+                            continue;
+                        }
+                        int64_t size = m_layout.getTypeAllocSize(iter.getIndexedType());
+                        if (constant) {
+                            offset += constant->getSExtValue() * size;
+                        } else {
+                            emit(AddScaled, 0, bitsOf(index->getType()), dst, current, use(index),
+                                 static_cast<uint64_t>(size));
+                            current = dst;
+                        }
+                    }
+                    if (offset || current != dst)
+                        emit(AddOffset, 0, 0, dst, current, 0, static_cast<uint64_t>(offset));
+                    break;
+                }
+                case llvm::Instruction::Add:  case llvm::Instruction::Sub:  case llvm::Instruction::Mul:
+                case llvm::Instruction::UDiv: case llvm::Instruction::SDiv: case llvm::Instruction::URem:
+                case llvm::Instruction::SRem: case llvm::Instruction::Shl:  case llvm::Instruction::LShr:
+                case llvm::Instruction::AShr: case llvm::Instruction::And:  case llvm::Instruction::Or:
+                case llvm::Instruction::Xor:
+                case llvm::Instruction::FAdd: case llvm::Instruction::FSub: case llvm::Instruction::FMul:
+                case llvm::Instruction::FDiv: case llvm::Instruction::FRem: {
+                    YacOpcode binary;
+                    switch (opcode) {
+                        case llvm::Instruction::Add:  binary = Add;  break;
+                        case llvm::Instruction::Sub:  binary = Sub;  break;
+                        case llvm::Instruction::Mul:  binary = Mul;  break;
+                        case llvm::Instruction::UDiv: binary = UDiv; break;
+                        case llvm::Instruction::SDiv: binary = SDiv; break;
+                        case llvm::Instruction::URem: binary = URem; break;
+                        case llvm::Instruction::SRem: binary = SRem; break;
+                        case llvm::Instruction::Shl:  binary = Shl;  break;
+                        case llvm::Instruction::LShr: binary = LShr; break;
+                        case llvm::Instruction::AShr: binary = AShr; break;
+                        case llvm::Instruction::And:  binary = And;  break;
+                        case llvm::Instruction::Or:   binary = Or;   break;
+                        case llvm::Instruction::Xor:  binary = Xor;  break;
+                        case llvm::Instruction::FAdd: binary = FAdd; break;
+                        case llvm::Instruction::FSub: binary = FSub; break;
+                        case llvm::Instruction::FMul: binary = FMul; break;
+                        case llvm::Instruction::FDiv: binary = FDiv; break;
+                        default:                      binary = FRem; break;
+                    }
+                    emit(binary, bitsOf(type), 0, dst, use(instruction.getOperand(0)),
+                         use(instruction.getOperand(1)), 0);
+                    break;
+                }
+                case llvm::Instruction::ICmp:
+                case llvm::Instruction::FCmp: {
+                    auto compare = llvm::cast<llvm::CmpInst>(&instruction);
+                    emit(opcode == llvm::Instruction::ICmp ? ICmp : FCmp, bitsOf(compare->getOperand(0)->getType()),
+                         compare->getPredicate(), dst, use(compare->getOperand(0)), use(compare->getOperand(1)), 0);
+                    break;
+                }
+                case llvm::Instruction::Select: {
+                    auto select = llvm::cast<llvm::SelectInst>(&instruction);
+                    emit(Select, 0, 0, dst, use(select->getCondition()), use(select->getTrueValue()),
+                         use(select->getFalseValue()));
+                    break;
+                }
+                case llvm::Instruction::ZExt:
+                case llvm::Instruction::IntToPtr:
+                case llvm::Instruction::Trunc:
+                case llvm::Instruction::PtrToInt:
+                case llvm::Instruction::BitCast:
+                    // integers are zero-extended already
+                    emit(type->isIntegerTy() && opcode != llvm::Instruction::ZExt ? Mask : Mov, bitsOf(type), 0, dst,
+                         use(instruction.getOperand(0)), 0, 0);
+                    break;
+                case llvm::Instruction::SExt:
+                case llvm::Instruction::FPToSI: case llvm::Instruction::FPToUI:
+                case llvm::Instruction::SIToFP: case llvm::Instruction::UIToFP:
+                case llvm::Instruction::FPExt:  case llvm::Instruction::FPTrunc: {
+                    YacOpcode conversion;
+                    switch (opcode) {
+                        case llvm::Instruction::SExt:   conversion = SExt;   break;
+                        case llvm::Instruction::FPToSI: conversion = FPToSI; break;
+                        case llvm::Instruction::FPToUI: conversion = FPToUI; break;
+                        case llvm::Instruction::SIToFP: conversion = SIToFP; break;
+                        case llvm::Instruction::UIToFP: conversion = UIToFP; break;
+                        case llvm::Instruction::FPExt:  conversion = FPExt;  break;
+                        default:                        conversion = FPTrunc; break;
+                    }
+                    auto operand = instruction.getOperand(0);
+                    emit(conversion, bitsOf(type), bitsOf(operand->getType()), dst, use(operand), 0, 0);
+                    break;
+                }
+                case llvm::Instruction::Call: {
+                    auto call = llvm::cast<llvm::CallInst>(&instruction);
+                    auto callee = llvm::dyn_cast<llvm::Function>(call->getCalledValue()->stripPointerCasts());
+                    if (callee && callee->isIntrinsic()) {
+                        // markers without effect on the execution
+                        if (llvm::isa<llvm::DbgInfoIntrinsic>(call) || callee->getIntrinsicID() == llvm::Intrinsic::lifetime_start
+                                || callee->getIntrinsicID() == llvm::Intrinsic::lifetime_end)
+                            break;
+                        fail("unsupported intrinsic `" + callee->getName().str() + '\'');
+                        break;
+                    }
+                    if (call->isInlineAsm()) {
+                        fail("inline assembly");
+                        break;
+                    }
+                    std::unique_ptr<CallSite> site(new CallSite);
+                    for (auto &arg: call->arg_operands())
+                        site->args.push_back(use(arg));
+                    site->result = dst;
+                    if (type->isIntegerTy())
+                        site->result_mask = mask(bitsOf(type));
+                    bool native = prepareNativeCall(*site, call);
+                    if (callee && !callee->isDeclaration()) {
+                        // the arguments land in the parameters as they are
+                        if (callee->getFunctionType() != call->getFunctionType()) {
+                            fail("call through a mismatched type");
+                            break;
+                        }
+                        site->callee = m_functions[callee];
+                    } else {
+                        if (!native) {
+                            fail("unsupported native call");
+                            break;
+                        }
+                        if (callee) {
+                            site->address = symbol(callee->getName());
+                            if (!site->address) {
+                                fail("undefined symbol `" + callee->getName().str() + '\'');
+                                break;
+                            }
+                        } else
+                            site->callee_register = use(call->getCalledValue());
+                    }
+                    emit(Call, 0, !type->isVoidTy(), dst, 0, 0, m_call_sites.size());
+                    m_call_sites.push_back(std::move(site));
+                    break;
+                }
+                case llvm::Instruction::Ret: {
+                    auto ret = llvm::cast<llvm::ReturnInst>(&instruction);
+                    auto value = ret->getReturnValue();
+                    emit(Return, 0, value != nullptr, 0, value ? use(value) : 0, 0, 0);
+                    break;
+                }
+                case llvm::Instruction::Br: {
+                    auto branch = llvm::cast<llvm::BranchInst>(&instruction);
+                    if (branch->isUnconditional() || branch->getSuccessor(0) == branch->getSuccessor(1)) {
+                        jump(&block, branch->getSuccessor(0));
+                        break;
+                    }
+                    auto index = code.size();
+                    emit(Branch, 0, 0, 0, use(branch->getCondition()), 0, 0);
+                    // an edge with phis gets a stub doing the moves
+                    for (unsigned int i = 0; i < 2; ++i) {
+                        auto successor = branch->getSuccessor(i);
+                        if (!llvm::isa<llvm::PHINode>(successor->front())) {
+                            fixups.push_back(Fixup{index, i == 1, successor});
+                            continue;
+                        }
+                        if (i == 0)
+                            code[index].imm = code.size();
+                        else
+                            code[index].b = static_cast<uint32_t>(code.size());
+                        jump(&block, successor);
+                    }
+                    break;
+                }
+                case llvm::Instruction::Unreachable:
+                    emit(Unreachable, 0, 0, 0, 0, 0, 0);
+                    break;
+                default:
+                    fail(std::string("unsupported instruction `") + instruction.getOpcodeName() + '\'');
+                    break;
+            }
+        }
+    }
+    if (failed)
+        return false;
+    for (auto &fixup: fixups) {
+        auto target = starts[fixup.block];
+        if (fixup.false_target)
+            code[fixup.index].b = static_cast<uint32_t>(target);
+        else
+            code[fixup.index].imm = target;
+    }
+    record.register_count = record.constant_base + static_cast<uint32_t>(record.constants.size());
+    // keeps the next frame aligned
+    record.frame_size = llvm::alignTo(record.frame_size, 16);
+    return true;
+}
+
+YacSlot YacInterpreter::invoke(Function &function, CallSite *site, const YacSlot *args) {
+    ++function.count;
+    // without a call site, the arguments cannot be described to libffi
+    if (site && site->native_callable && m_promotion && !function.promoted && function.count >= m_threshold) {
+        function.promoted = true;
+        function.native = m_promotion(function.function);
+    }
+    if (function.native && site && site->native_callable)
+        return callNative(function.native, *site, args);
+    return execute(function, args);
+}
+
+YacSlot YacInterpreter::call(CallSite &site, YacSlot *registers) {
+    llvm::SmallVector<YacSlot, 8> args;
+    for (auto arg: site.args)
+        args.push_back(registers[arg]);
+    if (site.callee)
+        return invoke(*site.callee, &site, args.data());
+    return callNative(site.address ? site.address : registers[site.callee_register].p, site, args.data());
+}
+
+YacSlot YacInterpreter::callNative(void *address, CallSite &site, const YacSlot *args) {
+    YacSlot result;
+    result.i = 0;
+#ifdef YAC_HAVE_FFI
+    llvm::SmallVector<void *, 8> values;
+    for (size_t i = 0; i < site.args.size(); ++i)
+        values.push_back(const_cast<YacSlot *>(&args[i]));
+    ffi_call(&site.cif, FFI_FN(address), &result, values.data());
+    // libffi widens small integers to a whole register
+    if (site.result_mask)
+        result.i &= site.result_mask;
+#else
+    // prepare() refuses native calls without libffi
+    (void) address;
+    (void) site;
+    (void) args;
+#endif
+    return result;
+}
+
+YacSlot YacInterpreter::execute(Function &function, const YacSlot *args) {
+    auto register_base = m_register_top;
+    auto stack_base = m_stack_top;
+    if (register_base + function.register_count > RegisterStackSize
+            || stack_base + function.frame_size > FrameStackSize) {
+        std::cerr << "yac: stack overflow in `" << function.function->getName().str() << '\'' << std::endl;
+        std::abort();
+    }
+    m_register_top += function.register_count;
+    m_stack_top += function.frame_size;
+    auto registers = &m_registers[register_base];
+    auto frame = &m_stack[stack_base];
+    std::copy(args, args + function.function->arg_size(), registers);
+    std::copy(function.constants.begin(), function.constants.end(), registers + function.constant_base);
+
+    auto code = function.code.data();
+    for (uint64_t pc = 0;; ++pc) {
+        auto &op = code[pc];
+        auto &dst = registers[op.dst];
+        switch (op.opcode) {
+            case Mov:
+                dst = registers[op.a];
+                break;
+            case Mask:
+                dst.i = registers[op.a].i & mask(op.width);
+                break;
+            case SExt:
+                dst.i = static_cast<uint64_t>(signExtend(registers[op.a].i, op.flag)) & mask(op.width);
+                break;
+#define YAC_INTEGER_CASE(opcode, expression) \
+            case opcode: { \
+                uint64_t a = registers[op.a].i, b = registers[op.b].i; \
+                (void) a; \
+                (void) b; \
+                dst.i = static_cast<uint64_t>(expression) & mask(op.width); \
+                break; \
+            }
+            YAC_INTEGER_CASE(Add, a + b)
+            YAC_INTEGER_CASE(Sub, a - b)
+            YAC_INTEGER_CASE(Mul, a * b)
+            YAC_INTEGER_CASE(UDiv, a / b)
+            YAC_INTEGER_CASE(SDiv, signExtend(a, op.width) / signExtend(b, op.width))
+            YAC_INTEGER_CASE(URem, a % b)
+            YAC_INTEGER_CASE(SRem, signExtend(a, op.width) % signExtend(b, op.width))
+            YAC_INTEGER_CASE(Shl, a << (b & 63))
+            YAC_INTEGER_CASE(LShr, a >> (b & 63))
+            YAC_INTEGER_CASE(AShr, signExtend(a, op.width) >> (b & 63))
+            YAC_INTEGER_CASE(And, a & b)
+            YAC_INTEGER_CASE(Or, a | b)
+            YAC_INTEGER_CASE(Xor, a ^ b)
+#undef YAC_INTEGER_CASE
+#define YAC_FLOATING_CASE(opcode, operator) \
+            case opcode: \
+                if (op.width == 32) \
+                    dst.f = registers[op.a].f operator registers[op.b].f; \
+                else \
+                    dst.d = registers[op.a].d operator registers[op.b].d; \
+                break;
+            YAC_FLOATING_CASE(FAdd, +)
+            YAC_FLOATING_CASE(FSub, -)
+            YAC_FLOATING_CASE(FMul, *)
+            YAC_FLOATING_CASE(FDiv, /)
+#undef YAC_FLOATING_CASE
+            case FRem:
+                if (op.width == 32)
+                    dst.f = std::fmod(registers[op.a].f, registers[op.b].f);
+                else
+                    dst.d = std::fmod(registers[op.a].d, registers[op.b].d);
+                break;
+            case ICmp:
+                dst.i = compareIntegers(op.flag, registers[op.a].i, registers[op.b].i, op.width);
+                break;
+            case FCmp:
+                if (op.width == 32)
+                    dst.i = compareFloating(op.flag, registers[op.a].f, registers[op.b].f);
+                else
+                    dst.i = compareFloating(op.flag, registers[op.a].d, registers[op.b].d);
+                break;
+            case FPToSI: {
+                double value = op.flag == 32 ? registers[op.a].f : registers[op.a].d;
+                dst.i = static_cast<uint64_t>(static_cast<int64_t>(value)) & mask(op.width);
+                break;
+            }
+            case FPToUI: {
+                double value = op.flag == 32 ? registers[op.a].f : registers[op.a].d;
+                dst.i = static_cast<uint64_t>(value) & mask(op.width);
+                break;
+            }
+            case SIToFP: {
+                auto value = signExtend(registers[op.a].i, op.flag);
+                if (op.width == 32)
+                    dst.f = static_cast<float>(value);
+                else
+                    dst.d = static_cast<double>(value);
+                break;
+            }
+            case UIToFP: {
+                auto value = registers[op.a].i;
+                if (op.width == 32)
+                    dst.f = static_cast<float>(value);
+                else
+                    dst.d = static_cast<double>(value);
+                break;
+            }
+            case FPExt:
+                dst.d = registers[op.a].f;
+                break;
+            case FPTrunc:
+                dst.f = static_cast<float>(registers[op.a].d);
+                break;
+            case Select:
+                dst = registers[registers[op.a].i & 1 ? op.b : op.imm];
+                break;
+            case Load:
+                dst.i = 0;
+                std::memcpy(&dst, registers[op.a].p, op.width);
+                break;
+            case Store:
+                std::memcpy(registers[op.b].p, &registers[op.a], op.width);
+                break;
+            case FrameAddress:
+                dst.p = frame + op.imm;
+                break;
+            case AddScaled:
+                dst.i = registers[op.a].i + static_cast<uint64_t>(signExtend(registers[op.b].i, op.flag)) * op.imm;
+                break;
+            case AddOffset:
+                dst.i = registers[op.a].i + op.imm;
+                break;
+            case Jump:
+                // a loop iteration
+                if (op.imm <= pc)
+                    ++function.count;
+                pc = op.imm - 1;
+                break;
+            case Branch: {
+                uint64_t target = registers[op.a].i & 1 ? op.imm : op.b;
+                if (target <= pc)
+                    ++function.count;
+                pc = target - 1;
+                break;
+            }
+            case Call: {
+                auto result = call(*m_call_sites[op.imm], registers);
+                if (op.flag)
+                    dst = result;
+                break;
+            }
+            case Return: {
+                YacSlot result;
+                result.i = 0;
+                if (op.flag)
+                    result = registers[op.a];
+                m_register_top = register_base;
+                m_stack_top = stack_base;
+                return result;
+            }
+            case Unreachable:
+                std::cerr << "yac: unreachable code reached in `" << function.function->getName().str() << '\''
+                          << std::endl;
+                std::abort();
+        }
+    }
+}
+
+int YacInterpreter::run(int argc, const char **argv) {
+    auto main = m_module.getFunction("main");
+    auto function = main ? m_functions.lookup(main) : nullptr;
+    if (!function || main->arg_size() > 2) {
+        std::cerr << "yac: cannot find main" << std::endl;
+        return 1;
+    }
+    YacSlot args[2];
+    args[0].i = static_cast<uint32_t>(argc);
+    args[1].p = const_cast<char **>(argv);
+    return static_cast<int>(invoke(*function, nullptr, args).i);
+}
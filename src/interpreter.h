@@ -0,0 +1,93 @@
+#ifndef INTERPRETER_H_INCLUDE
+#define INTERPRETER_H_INCLUDE
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/Module.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A register of the interpreter. Integers are kept zero-extended from their
+// width, a float lives in the low half.
+union YacSlot {
+    uint64_t i;
+    double d;
+    float f;
+    void *p;
+};
+
+// The first execution tier. Every function of the module is lowered once
+// into a compact register bytecode: SSA values become registers, constants
+// are preloaded registers, phis become moves on the incoming edges and static
+// allocas are offsets into the frame. Memory is the real memory of the
+// process, so external C functions are called through libffi with the
+// interpreter's own pointers.
+//
+// Calls and loop iterations are counted per function. Once a function
+// reaches the threshold, the promotion callback may hand back native code for
+// it and further calls from the interpreter go there instead.
+class YacInterpreter {
+public:
+    // returns the native address of `function', or nullptr to keep
+    // interpreting it
+    typedef std::function<void *(llvm::Function *function)> Promotion;
+
+    // `module' must outlive the interpreter
+    explicit YacInterpreter(llvm::Module &module);
+    ~YacInterpreter();
+    YacInterpreter(const YacInterpreter &) = delete;
+    YacInterpreter &operator = (const YacInterpreter &) = delete;
+
+    // Allocates the globals and lowers every function.
+    // return false with `error' set if the module uses something the
+    // interpreter does not handle (function pointers, intrinsics, vectors...)
+    bool prepare(std::string &error);
+    void setPromotion(uint64_t threshold, Promotion promotion) {
+        m_threshold = threshold;
+        m_promotion = std::move(promotion);
+    }
+    // the storage of a global variable of the module
+    void *globalAddress(const llvm::GlobalVariable *global) {
+        return m_globals.lookup(global);
+    }
+
+    // Runs `main' and returns its exit code.
+    int run(int argc, const char **argv);
+
+    struct Function;
+    struct CallSite;
+private:
+    bool lower(Function &function, std::string &error);
+    bool evaluate(const llvm::Constant *constant, YacSlot &slot);
+    bool initialize(char *address, const llvm::Constant *constant);
+    void *symbol(llvm::StringRef name);
+
+    YacSlot invoke(Function &function, CallSite *site, const YacSlot *args);
+    YacSlot execute(Function &function, const YacSlot *args);
+    YacSlot call(CallSite &site, YacSlot *registers);
+    YacSlot callNative(void *address, CallSite &site, const YacSlot *args);
+
+    llvm::Module &m_module;
+    const llvm::DataLayout &m_layout;
+    llvm::DenseMap<const llvm::GlobalVariable *, void *> m_globals;
+    std::vector<std::unique_ptr<char[]>> m_storage;
+    llvm::DenseMap<const llvm::Function *, Function *> m_functions;
+    std::vector<std::unique_ptr<Function>> m_function_list;
+    std::vector<std::unique_ptr<CallSite>> m_call_sites;
+
+    uint64_t m_threshold = 0;
+    Promotion m_promotion;
+
+    // stacks of the registers and of the allocas of the active frames
+    std::unique_ptr<YacSlot[]> m_registers;
+    size_t m_register_top = 0;
+    std::unique_ptr<char[]> m_stack;
+    size_t m_stack_top = 0;
+};
+
+#endif
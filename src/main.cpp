@@ -1,29 +1,59 @@
 #include <iostream>
 #include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+#include <thread>
 #include <llvm/Support/TargetSelect.h>
-#include <llvm/ExecutionEngine/MCJIT.h>
 #include <llvm/Support/FileSystem.h>
-#include "ast/ast.h"
-#include "ast/context.h"
-#include "ast/expression.h"
-#include "ast/declaration.h"
+#include <llvm/Support/Path.h>
+#include "compiler.h"
+#include "driver.h"
+#include "profile.h"
+#include "server.h"
+#include "trace.h"
 
 using namespace std;
 using namespace llvm;
 
-extern FILE* yyin;
-extern int yyparse();
-
 const char *default_args[] = {"main"};
 
-int main(int argc, const char **argv) try {
-    bool compile = false, jit = false;
+// The trace of --time-report and --time-trace is written when yac exits,
+// which the program executed may do on its own.
+static bool time_report = false;
+static string time_trace;
+
+static void finishTimeTrace() {
+    string error;
+    if (!YacTimeTrace::finish(time_report ? &cerr : nullptr, time_trace, error))
+        cerr << "yac: " << error << std::endl;
+}
+
+static int run(int argc, const char **argv) {
+    bool compile = false, jit = false, preprocess_only = false, emit_llvm = false;
     const char *output = nullptr;
+    // where the counts of an executed program go
+    string profile_generate;
+    unsigned int jobs = 1;
+    YacCompileOptions options;
     int i;
     for (i = 1; i < argc; ++i) {
         const char *arg = argv[i];
-        if (strcmp(arg, "-c") == 0 || strcmp(arg, "--compile") == 0)
+        if (strcmp(arg, "-c") == 0 || strcmp(arg, "--compile") == 0) {
+            compile = true;
+            options.output = YacOutputKind::Object;
+        } else if (strcmp(arg, "-S") == 0) {
+            compile = true;
+            options.output = YacOutputKind::Assembly;
+        } else if (strcmp(arg, "--emit-llvm") == 0)
+            emit_llvm = true;
+        else if (strcmp(arg, "--emit-bc") == 0) {
             compile = true;
+            options.output = YacOutputKind::Bitcode;
+        } else if (strcmp(arg, "--module-summary") == 0)
+            options.module_summary = true;
         else if (strcmp(arg, "-e") == 0 || strcmp(arg, "--execute") == 0)
             jit = true;
         else if (strcmp(arg, "-o") == 0 || strcmp(arg, "--output") == 0) {
@@ -33,43 +63,187 @@ int main(int argc, const char **argv) try {
                 cerr << "yac: missing output file" << std::endl;
                 return 1;
             }
+        } else if (strcmp(arg, "-E") == 0)
+            preprocess_only = true;
+        else if (strcmp(arg, "--no-preprocess") == 0)
+            options.preprocess = false;
+        else if (strncmp(arg, "-I", 2) == 0 || strncmp(arg, "-D", 2) == 0) {
+            // -Idir, -I dir, -DNAME[=VALUE], -D NAME[=VALUE]
+            const char *value = arg + 2;
+            if (*value == '\0') {
+                if (++i == argc) {
+                    cerr << "yac: missing argument to `" << arg << '\'' << std::endl;
+                    return 1;
+                }
+                value = argv[i];
+            }
+            (arg[1] == 'I' ? options.preprocessor.include_dirs : options.preprocessor.defines).emplace_back(value);
+        } else if (strncmp(arg, "-O", 2) == 0) {
+            // -O is -O1
+            static const char *const levels[] = {"0", "1", "2", "3", "s"};
+            const char *level = arg[2] ? arg + 2 : "1";
+            auto found = find_if(begin(levels), end(levels), [=](const char *name) { return strcmp(name, level) == 0; });
+            if (found == end(levels)) {
+                cerr << "yac: invalid optimization level `" << arg << '\'' << std::endl;
+                return 1;
+            }
+            options.optimization = static_cast<YacOptimizationLevel>(found - begin(levels));
+        } else if (strncmp(arg, "-mcpu=", 6) == 0 || strncmp(arg, "-march=", 7) == 0)
+            // as with clang on x86, both name the CPU, `native' being the host
+            options.cpu = strchr(arg, '=') + 1;
+        else if (strncmp(arg, "--relocation-model=", 19) == 0) {
+            const char *model = arg + 19;
+            if (strcmp(model, "static") == 0)
+                options.relocation_model = Reloc::Static;
+            else if (strcmp(model, "pic") == 0)
+                options.relocation_model = Reloc::PIC_;
+            else if (strcmp(model, "dynamic-no-pic") == 0)
+                options.relocation_model = Reloc::DynamicNoPIC;
+            else {
+                cerr << "yac: invalid relocation model `" << model << '\'' << std::endl;
+                return 1;
+            }
+        } else if (strncmp(arg, "--codegen-threads=", 18) == 0) {
+            // 0 for one thread per core
+            options.codegen_threads = static_cast<unsigned int>(atoi(arg + 18));
+            if (options.codegen_threads == 0)
+                options.codegen_threads = std::max(std::thread::hardware_concurrency(), 1u);
+        } else if (strcmp(arg, "--jit=lazy") == 0)
+            options.jit = YacJitKind::Lazy;
+        else if (strcmp(arg, "--jit=mcjit") == 0)
+            options.jit = YacJitKind::MCJIT;
+        else if (strcmp(arg, "--jit=tiered") == 0)
+            options.jit = YacJitKind::Tiered;
+        else if (strncmp(arg, "--tier-up=", 10) == 0)
+            options.tier_up_threshold = strtoull(arg + 10, nullptr, 10);
+        else if (strncmp(arg, "--jit-cache=", 12) == 0)
+            options.jit_cache = arg + 12;
+        else if (strncmp(arg, "--jit-cache-size=", 17) == 0)
+            // in megabytes
+            options.jit_cache_size = strtoull(arg + 17, nullptr, 10) << 20;
+        else if (strcmp(arg, "--profile-generate") == 0)
+            profile_generate = "yac.profile";
+        else if (strncmp(arg, "--profile-generate=", 19) == 0)
+            profile_generate = arg + 19;
+        else if (strncmp(arg, "--profile-use=", 14) == 0)
+            options.profile_use = arg + 14;
+        else if (strcmp(arg, "--whole-program") == 0)
+            options.whole_program = true;
+        else if (strcmp(arg, "--time-report") == 0)
+            time_report = true;
+        else if (strncmp(arg, "--time-trace=", 13) == 0)
+            time_trace = arg + 13;
+        else if (strcmp(arg, "--stream") == 0)
+            options.streaming = true;
+        else if (strncmp(arg, "-j", 2) == 0 || strncmp(arg, "--jobs=", 7) == 0) {
+            // -jN, -j N, --jobs=N, or -j alone for one job per core
+            const char *value = arg[1] == 'j' ? arg + 2 : arg + 7;
+            if (*value == '\0' && arg[1] == 'j' && i + 1 < argc && isdigit(argv[i + 1][0]))
+                value = argv[++i];
+            jobs = *value ? static_cast<unsigned int>(atoi(value)) : std::thread::hardware_concurrency();
+            if (jobs == 0)
+                jobs = 1;
         } else
             break;
     }
+    // as with clang, `-c --emit-llvm' is bitcode and `-S --emit-llvm' is IR
+    if (emit_llvm) {
+        compile = true;
+        options.output = options.output == YacOutputKind::Object ? YacOutputKind::Bitcode : YacOutputKind::IR;
+    }
     if (output != nullptr)
         compile = true;
-    if (!compile)
+    if (time_report || !time_trace.empty()) {
+        YacTimeTrace::start();
+        atexit(finishTimeTrace);
+    }
+    if (!compile && !preprocess_only)
         jit = true;
-    if (i < argc) {
-        yyin = fopen(argv[i], "r");
-        if (yyin == nullptr) {
-            cerr << "yac: cannot open input file" << std::endl;
+    // the counters live in this process
+    if (!profile_generate.empty() && (compile || !jit)) {
+        cerr << "yac: --profile-generate only applies to programs executed without output" << std::endl;
+        return 1;
+    }
+
+    // Input files come first. When executing, only the first one is an input
+    // unless the program arguments are separated from the inputs by `--'.
+    vector<string> inputs;
+    vector<const char *> program_args;
+    int separator = i;
+    while (separator < argc && strcmp(argv[separator], "--") != 0)
+        ++separator;
+    int inputs_end = separator < argc ? separator : (jit && i < argc ? i + 1 : argc);
+    for (; i < inputs_end; ++i)
+        inputs.emplace_back(argv[i]);
+    if (inputs.empty())
+        inputs.emplace_back("-");
+    if (i < argc && i == separator)
+        ++i;
+    program_args.push_back(inputs[0] == "-" ? default_args[0] : inputs[0].c_str());
+    for (; i < argc; ++i)
+        program_args.push_back(argv[i]);
+
+    if (preprocess_only) {
+        if (!output)
+            return preprocessToStream(inputs, options, outs()) ? 0 : 1;
+        std::error_code err;
+        raw_fd_ostream out(output, err, sys::fs::F_Text);
+        if (err) {
+            cerr << "yac: cannot open output file" << std::endl;
             return 1;
         }
-        input = argv[i];
-    } else
-        yyin = stdin;
+        return preprocessToStream(inputs, options, out) ? 0 : 1;
+    }
 
-    if (yyparse() && !root)
-        return 1;
+    // the optimizer queries the host target as well as the JIT
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+    InitializeNativeTargetAsmParser();
 
-    YacSemanticAnalyzer context;
-    root->generate(context);
-    if (compile) {
-        if (output) {
-            std::error_code err;
-            raw_fd_ostream out(output, err, sys::fs::F_Text);
-            if (err) {
-                cerr << "yac: cannot open output file" << std::endl;
-                return 1;
-            }
-            context.print(out);
-        } else
-            context.print(outs());
+    static const char *const extensions[] = {"ll", "bc", "s", "o"};
+    auto extension = extensions[static_cast<int>(options.output)];
+    // a whole program, or one also executed, is linked into one module, its
+    // output is named after the first input, IR going to the standard output
+    // unless the program writes there
+    string program_output;
+    if (compile && !output && (jit || (options.whole_program && options.output != YacOutputKind::IR))) {
+        SmallString<128> path(inputs[0] == "-" ? default_args[0] : inputs[0]);
+        sys::path::replace_extension(path, extension);
+        program_output = path.str().str();
+        output = program_output.c_str();
+    }
+    // IR of a single input goes to the standard output
+    if (compile && !output && !jit && !options.whole_program
+            && (inputs.size() > 1 || options.output != YacOutputKind::IR)) {
+        // one output per input: a.c -> a.ll, a.bc, a.s or a.o
+        vector<string> outputs;
+        for (auto &input: inputs) {
+            SmallString<128> path(input == "-" ? default_args[0] : input);
+            sys::path::replace_extension(path, extension);
+            outputs.emplace_back(path.str());
+        }
+        return compileToFiles(inputs, outputs, jobs, options) ? 0 : 1;
     }
 
+    // a module only executed here is optimized for this machine, as the JIT
+    // generates code for it
+    if (jit && !compile && options.cpu.empty())
+        options.cpu = "native";
+    LLVMContext context;
+    auto module = compileAndLink(inputs, jobs, options, context);
+    if (!module)
+        return 1;
+    // before the optimizer, which the profile is applied ahead of as well
+    unique_ptr<YacProfileCounters> counters;
+    if (!profile_generate.empty())
+        counters.reset(new YacProfileCounters(*module));
+    if (!optimizeModule(*module, options))
+        return 1;
+    if (compile && !writeModule(*module, output ? output : "-", options, cerr))
+        return 1;
+
     if (jit) {
-        llvm::Value *func = context.find(findInScopes("main"));
+        llvm::Value *func = module->getNamedValue("main");
         if (!func) {
             cerr << "yac: cannot find main" << std::endl;
             return 1;
@@ -78,18 +252,38 @@ int main(int argc, const char **argv) try {
             cerr << "yac: main is non-function" << std::endl;
             return 1;
         }
+        int result = executeModule(std::move(module), static_cast<int>(program_args.size()), program_args.data(),
+                                   options);
+        string error;
+        if (counters && !counters->save(profile_generate, error))
+            cerr << "yac: " << error << std::endl;
+        return result;
+    }
+    return 0;
+}
+
+// Tokenizes the common headers into the header cache, which the processes
+// serving requests inherit.
+static void warmHeaders() {
+    static const char prelude[] = "#include <stdio.h>\n#include <stdlib.h>\n#include <string.h>\n"
+                                  "#include <ctype.h>\n#include <math.h>\n";
+    YacSourceBuffer source;
+    source.assign(prelude, sizeof(prelude) - 1);
+    ostringstream diagnostics;
+    YacCompileOptions options;
+    options.diagnostics = &diagnostics;
+    raw_null_ostream out;
+    preprocessSource(source, out, options);
+}
+
+int main(int argc, const char **argv) {
+    // yac --serve SOCKET: run the command lines of yac-client
+    if (argc == 3 && strcmp(argv[1], "--serve") == 0) {
         InitializeNativeTarget();
         InitializeNativeTargetAsmPrinter();
         InitializeNativeTargetAsmParser();
-        if (i < argc)
-            return context.execute(llvm::cast<llvm::Function>(func), argc - i, argv);
-        return context.execute(llvm::cast<llvm::Function>(func), sizeof(default_args) / sizeof(default_args[0]), default_args);
+        warmHeaders();
+        return serveRequests(argv[2], run, cerr);
     }
-    return 0;
-} catch (YacSemanticError &err) {
-    cerr << "yac: " << err << std::endl;
-    return 1;
-} catch (YacSyntaxError &err) {
-    cerr << "yac: " << err << std::endl;
-    return 1;
-}
\ No newline at end of file
+    return run(argc, argv);
+}
@@ -0,0 +1,353 @@
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/ProfileData/InstrProf.h>
+#include <llvm/ProfileData/ProfileCommon.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include "profile.h"
+
+// callees remembered per indirect call site
+static const unsigned int TargetSlots = 3;
+
+static bool isIndirectCall(const llvm::Instruction &instruction) {
+    auto call = llvm::dyn_cast<llvm::CallInst>(&instruction);
+    return call && !call->isInlineAsm() && !llvm::isa<llvm::Function>(call->getCalledValue()->stripPointerCasts());
+}
+
+// the successors of `block' which get a counter each
+static unsigned int countedSuccessors(const llvm::BasicBlock &block) {
+    auto terminator = block.getTerminator();
+    if (!terminator || !(llvm::isa<llvm::BranchInst>(terminator) || llvm::isa<llvm::SwitchInst>(terminator)))
+        return 0;
+    auto successors = terminator->getNumSuccessors();
+    return successors > 1 ? successors : 0;
+}
+
+struct YacFunctionShape {
+    uint64_t hash;
+    size_t edges, sites;
+};
+
+static YacFunctionShape functionShape(const llvm::Function &function) {
+    YacFunctionShape shape{0, 0, 0};
+    std::string text;
+    for (auto &block: function) {
+        for (auto &instruction: block)
+            if (isIndirectCall(instruction)) {
+                ++shape.sites;
+                text += "call ";
+            }
+        auto successors = countedSuccessors(block);
+        shape.edges += successors;
+        text += std::to_string(successors) + ' ';
+    }
+    llvm::MD5 md5;
+    md5.update(text);
+    llvm::MD5::MD5Result result;
+    md5.final(result);
+    shape.hash = result.low();
+    return shape;
+}
+
+bool readProfile(const std::string &path, YacProfileData &data, std::string &error) {
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer) {
+        error = "cannot read profile `" + path + "': " + buffer.getError().message();
+        return false;
+    }
+    llvm::SmallVector<llvm::StringRef, 16> lines, fields;
+    (*buffer)->getBuffer().split(lines, '\n', -1, false);
+    for (size_t i = 0; i < lines.size(); ++i) {
+        fields.clear();
+        lines[i].split(fields, ' ', -1, false);
+        auto malformed = [&]() {
+            error = "malformed profile `" + path + "' at line " + std::to_string(i + 1);
+            return false;
+        };
+        if (fields.size() < 3)
+            return malformed();
+        auto &profile = data[fields[1].str()];
+        if (fields[0] == "function") {
+            if (fields[2].getAsInteger(10, profile.hash))
+                return malformed();
+            profile.counts.resize(fields.size() - 3);
+            for (size_t j = 3; j < fields.size(); ++j)
+                if (fields[j].getAsInteger(10, profile.counts[j - 3]))
+                    return malformed();
+        } else if (fields[0] == "targets") {
+            size_t site;
+            if (fields[2].getAsInteger(10, site) || fields.size() % 2 == 0)
+                return malformed();
+            if (profile.targets.size() <= site)
+                profile.targets.resize(site + 1);
+            for (size_t j = 3; j < fields.size(); j += 2) {
+                uint64_t count;
+                if (fields[j + 1].getAsInteger(10, count))
+                    return malformed();
+                profile.targets[site].emplace_back(fields[j].str(), count);
+            }
+        } else
+            return malformed();
+    }
+    return true;
+}
+
+bool writeProfile(const std::string &path, const YacProfileData &data, std::string &error) {
+    std::error_code err;
+    llvm::raw_fd_ostream out(path, err, llvm::sys::fs::F_Text);
+    if (err) {
+        error = "cannot write profile `" + path + "': " + err.message();
+        return false;
+    }
+    for (auto &entry: data) {
+        auto &profile = entry.second;
+        out << "function " << entry.first << ' ' << profile.hash;
+        for (auto count: profile.counts)
+            out << ' ' << count;
+        out << '\n';
+        for (size_t site = 0; site < profile.targets.size(); ++site) {
+            if (profile.targets[site].empty())
+                continue;
+            out << "targets " << entry.first << ' ' << site;
+            for (auto &target: profile.targets[site])
+                out << ' ' << target.first << ' ' << target.second;
+            out << '\n';
+        }
+    }
+    return true;
+}
+
+void applyProfile(llvm::Module &module, const YacProfileData &data, std::ostream &diagnostics) {
+    llvm::InstrProfSummaryBuilder summary(llvm::ProfileSummaryBuilder::DefaultCutoffs);
+    llvm::MDBuilder md(module.getContext());
+    bool applied = false;
+    for (auto &function: module) {
+        if (function.isDeclaration())
+            continue;
+        auto found = data.find(function.getName().str());
+        if (found == data.end())
+            continue;
+        auto &profile = found->second;
+        auto shape = functionShape(function);
+        if (profile.hash != shape.hash || profile.counts.size() != shape.edges + 1
+                || profile.targets.size() > shape.sites) {
+            diagnostics << "yac: warning: the profile of `" << function.getName().str() << "' does not match its code"
+                        << std::endl;
+            continue;
+        }
+        applied = true;
+        function.setEntryCount(profile.counts[0]);
+        summary.addRecord(llvm::InstrProfRecord(profile.counts));
+        size_t edge = 1, site = 0;
+        for (auto &block: function) {
+            for (auto &instruction: block) {
+                if (!isIndirectCall(instruction))
+                    continue;
+                if (site >= profile.targets.size())
+                    break;
+                // the optimizer knows the callees by the hash of their names
+                llvm::SmallVector<InstrProfValueData, TargetSlots> values;
+                uint64_t sum = 0;
+                for (auto &target: profile.targets[site++]) {
+                    auto callee = module.getFunction(target.first);
+                    if (!callee)
+                        continue;
+                    values.push_back(InstrProfValueData{
+                            llvm::IndexedInstrProf::ComputeHash(llvm::getPGOFuncName(*callee)), target.second});
+                    sum += target.second;
+                }
+                std::sort(values.begin(), values.end(),
+                          [](const InstrProfValueData &a, const InstrProfValueData &b) {
+                              return a.Count > b.Count;
+                          });
+                if (sum)
+                    llvm::annotateValueSite(module, instruction, values, sum, llvm::IPVK_IndirectCallTarget,
+                                            TargetSlots);
+            }
+            auto successors = countedSuccessors(block);
+            if (!successors)
+                continue;
+            auto begin = profile.counts.begin() + edge;
+            edge += successors;
+            auto max = *std::max_element(begin, begin + successors);
+            if (!max)
+                continue;
+            // weights are 32-bit
+            uint64_t scale = max / UINT32_MAX + 1;
+            llvm::SmallVector<uint32_t, 4> weights;
+            for (auto count = begin; count != begin + successors; ++count)
+                weights.push_back(static_cast<uint32_t>(*count / scale));
+            block.getTerminator()->setMetadata(llvm::LLVMContext::MD_prof, md.createBranchWeights(weights));
+        }
+    }
+    if (applied)
+        module.setProfileSummary(summary.getSummary()->getMD(module.getContext()));
+}
+
+
+static void increment(llvm::IRBuilder<> &builder, llvm::Value *counter) {
+    auto value = builder.CreateLoad(counter);
+    builder.CreateStore(builder.CreateAdd(value, llvm::ConstantInt::get(value->getType(), 1)), counter);
+}
+
+// `void yac.profile.target(i64 *slots, i64 callee)' counts a call of `callee'
+// in the first free or matching pair of `slots'
+static llvm::Function *createTargetRecorder(llvm::Module &module) {
+    auto &context = module.getContext();
+    auto int64 = llvm::Type::getInt64Ty(context);
+    auto type = llvm::FunctionType::get(llvm::Type::getVoidTy(context), {int64->getPointerTo(), int64}, false);
+    auto function = llvm::Function::Create(type, llvm::GlobalValue::InternalLinkage, "yac.profile.target", &module);
+    auto args = function->arg_begin();
+    llvm::Value *slots = &*args++, *callee = &*args;
+    llvm::IRBuilder<> builder(llvm::BasicBlock::Create(context, "", function));
+    for (unsigned int i = 0; i < TargetSlots; ++i) {
+        auto key = builder.CreateInBoundsGEP(slots, llvm::ConstantInt::get(int64, 2 * i));
+        auto count = builder.CreateInBoundsGEP(slots, llvm::ConstantInt::get(int64, 2 * i + 1));
+        auto current = builder.CreateLoad(key);
+        auto hit = llvm::BasicBlock::Create(context, "", function);
+        auto miss = llvm::BasicBlock::Create(context, "", function);
+        auto claim = llvm::BasicBlock::Create(context, "", function);
+        auto next = llvm::BasicBlock::Create(context, "", function);
+        builder.CreateCondBr(builder.CreateICmpEQ(current, callee), hit, miss);
+        builder.SetInsertPoint(hit);
+        increment(builder, count);
+        builder.CreateRetVoid();
+        builder.SetInsertPoint(miss);
+        builder.CreateCondBr(builder.CreateICmpEQ(current, llvm::ConstantInt::get(int64, 0)), claim, next);
+        builder.SetInsertPoint(claim);
+        builder.CreateStore(callee, key);
+        builder.CreateStore(llvm::ConstantInt::get(int64, 1), count);
+        builder.CreateRetVoid();
+        builder.SetInsertPoint(next);
+    }
+    // every slot is taken by another callee
+    builder.CreateRetVoid();
+    return function;
+}
+
+llvm::Constant *YacProfileCounters::counter(llvm::LLVMContext &context, size_t index) const {
+    auto int64 = llvm::Type::getInt64Ty(context);
+    auto address = llvm::ConstantInt::get(int64, reinterpret_cast<uintptr_t>(&m_counters[index]));
+    return llvm::ConstantExpr::getIntToPtr(address, int64->getPointerTo());
+}
+
+YacProfileCounters::YacProfileCounters(llvm::Module &module) {
+    auto &context = module.getContext();
+    auto int64 = llvm::Type::getInt64Ty(context);
+    std::vector<llvm::Function *> functions, targets;
+    size_t size = 0;
+    for (auto &function: module) {
+        if (function.isDeclaration())
+            continue;
+        auto shape = functionShape(function);
+        m_functions.push_back(Function{function.getName().str(), shape.hash, size, shape.edges + 1, shape.sites});
+        size += shape.edges + 1 + shape.sites * 2 * TargetSlots;
+        functions.push_back(&function);
+        if (function.hasAddressTaken()) {
+            m_targets.push_back(function.getName().str());
+            targets.push_back(&function);
+        }
+    }
+    m_table = size;
+    m_counters.reset(new uint64_t[size + targets.size()]());
+
+    llvm::Function *recorder = nullptr;
+    for (size_t i = 0; i < functions.size(); ++i) {
+        auto &function = *functions[i];
+        auto &record = m_functions[i];
+        llvm::IRBuilder<> builder(&*function.getEntryBlock().getFirstInsertionPt());
+        increment(builder, counter(context, record.offset));
+        size_t edge = record.offset + 1, site = record.offset + record.counters;
+        for (auto &block: function) {
+            std::vector<llvm::CallInst *> calls;
+            for (auto &instruction: block)
+                if (isIndirectCall(instruction))
+                    calls.push_back(llvm::cast<llvm::CallInst>(&instruction));
+            for (auto call: calls) {
+                if (!recorder)
+                    recorder = createTargetRecorder(module);
+                builder.SetInsertPoint(call);
+                builder.CreateCall(recorder, {counter(context, site), builder.CreatePtrToInt(call->getCalledValue(), int64)});
+                site += 2 * TargetSlots;
+            }
+            auto successors = countedSuccessors(block);
+            if (!successors)
+                continue;
+            // the successor taken picks the counter
+            auto terminator = block.getTerminator();
+            builder.SetInsertPoint(terminator);
+            llvm::Value *index;
+            if (auto branch = llvm::dyn_cast<llvm::BranchInst>(terminator))
+                index = builder.CreateSelect(branch->getCondition(), llvm::ConstantInt::get(int64, edge),
+                                             llvm::ConstantInt::get(int64, edge + 1));
+            else {
+                auto switch_inst = llvm::cast<llvm::SwitchInst>(terminator);
+                index = llvm::ConstantInt::get(int64, edge);
+                for (auto &c: switch_inst->cases())
+                    index = builder.CreateSelect(builder.CreateICmpEQ(switch_inst->getCondition(), c.getCaseValue()),
+                                                 llvm::ConstantInt::get(int64, edge + c.getSuccessorIndex()), index);
+            }
+            increment(builder, builder.CreateInBoundsGEP(counter(context, 0), index));
+            edge += successors;
+        }
+    }
+
+    // main publishes the addresses the indirect calls are compared with
+    auto main = module.getFunction("main");
+    if (targets.empty() || !main || main->isDeclaration())
+        return;
+    llvm::IRBuilder<> builder(&*main->getEntryBlock().getFirstInsertionPt());
+    for (size_t i = 0; i < targets.size(); ++i)
+        builder.CreateStore(builder.CreatePtrToInt(targets[i], int64), counter(context, m_table + i));
+}
+
+void YacProfileCounters::collect(YacProfileData &data) const {
+    std::map<uint64_t, std::string> names;
+    for (size_t i = 0; i < m_targets.size(); ++i)
+        names[m_counters[m_table + i]] = m_targets[i];
+    for (auto &function: m_functions) {
+        auto counts = &m_counters[function.offset];
+        auto &profile = data[function.name];
+        // a profile of older code is replaced
+        if (profile.hash != function.hash || profile.counts.size() != function.counters) {
+            profile = YacFunctionProfile();
+            profile.hash = function.hash;
+            profile.counts.assign(function.counters, 0);
+        }
+        profile.targets.resize(function.sites);
+        for (size_t i = 0; i < function.counters; ++i)
+            profile.counts[i] += counts[i];
+        for (size_t site = 0; site < function.sites; ++site) {
+            auto slots = counts + function.counters + site * 2 * TargetSlots;
+            auto &targets = profile.targets[site];
+            for (unsigned int i = 0; i < TargetSlots; ++i) {
+                auto name = names.find(slots[2 * i]);
+                if (name == names.end())
+                    continue;
+                auto target = std::find_if(targets.begin(), targets.end(),
+                                           [&](const std::pair<std::string, uint64_t> &target) {
+                                               return target.first == name->second;
+                                           });
+                if (target == targets.end())
+                    targets.emplace_back(name->second, slots[2 * i + 1]);
+                else
+                    target->second += slots[2 * i + 1];
+            }
+        }
+    }
+}
+
+bool YacProfileCounters::save(const std::string &path, std::string &error) const {
+    YacProfileData data;
+    // counts of earlier runs are kept
+    if (llvm::sys::fs::exists(path) && !readProfile(path, data, error))
+        return false;
+    collect(data);
+    return writeProfile(path, data, error);
+}
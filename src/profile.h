@@ -0,0 +1,72 @@
+#ifndef PROFILE_H_INCLUDE
+#define PROFILE_H_INCLUDE
+
+#include <llvm/IR/Module.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// What a run counted in one function: counts[0] is the number of calls,
+// then come the successors of each conditional branch and switch, in the
+// order of the blocks. `hash' covers the shape of the function, so a stale
+// profile is never applied to changed code.
+struct YacFunctionProfile {
+    uint64_t hash = 0;
+    std::vector<uint64_t> counts;
+    // per indirect call site, the callees and how often each was called
+    std::vector<std::vector<std::pair<std::string, uint64_t>>> targets;
+};
+
+// by function name
+typedef std::map<std::string, YacFunctionProfile> YacProfileData;
+
+// The text profile format, one line per function and per indirect call site:
+//     function <name> <hash> <count>...
+//     targets <name> <site> <callee> <count>...
+// return false and set `error' if the file cannot be read or is malformed
+bool readProfile(const std::string &path, YacProfileData &data, std::string &error);
+bool writeProfile(const std::string &path, const YacProfileData &data, std::string &error);
+
+// Gives the functions of `module' matching `data' their entry counts, the
+// branch weights of their branches and the callees of their indirect calls,
+// plus the profile summary of the module. The optimizer then inlines hot
+// calls, promotes indirect ones and lays the blocks out by frequency.
+void applyProfile(llvm::Module &module, const YacProfileData &data, std::ostream &diagnostics);
+
+// The counters of an instrumented module to be executed in this process.
+// The code adds to them in place, through their absolute addresses.
+class YacProfileCounters {
+public:
+    // Instruments every function defined in `module', which must not have
+    // been optimized yet so that its shape matches the module the profile
+    // is applied to.
+    explicit YacProfileCounters(llvm::Module &module);
+    YacProfileCounters(const YacProfileCounters &) = delete;
+    YacProfileCounters &operator = (const YacProfileCounters &) = delete;
+
+    // Adds the counts to the profile at `path', if any, and writes it back.
+    // return false and set `error' on failure
+    bool save(const std::string &path, std::string &error) const;
+private:
+    struct Function {
+        std::string name;
+        uint64_t hash;
+        size_t offset, counters, sites;
+    };
+
+    void collect(YacProfileData &data) const;
+    llvm::Constant *counter(llvm::LLVMContext &context, size_t index) const;
+
+    std::vector<Function> m_functions;
+    // functions which indirect calls may reach, their addresses are stored
+    // from `m_table'
+    std::vector<std::string> m_targets;
+    size_t m_table = 0;
+    std::unique_ptr<uint64_t[]> m_counters;
+};
+
+#endif
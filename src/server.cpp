@@ -0,0 +1,149 @@
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include "server.h"
+
+// Waits for `worker' to exit, which closes the write end of `exited'.
+// Meanwhile the signals the client forwards go to the worker, and the worker
+// is killed if the client goes away, as with Ctrl-C on a yac running in the
+// terminal.
+static void superviseWorker(int connection, pid_t worker, int exited) {
+    pollfd watched[2] = {{connection, POLLIN, 0}, {exited, POLLIN, 0}};
+    for (;;) {
+        if (poll(watched, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        if (watched[1].revents)
+            return;
+        if (!watched[0].revents)
+            continue;
+        unsigned char number;
+        auto count = read(connection, &number, 1);
+        if (count == 1)
+            kill(worker, number);
+        else if (count == 0 || errno != EINTR) {
+            // nobody is left to report to
+            kill(worker, SIGKILL);
+            watched[0].fd = -1;
+        }
+    }
+}
+
+// Runs in a child of the server: forks the process running the request and
+// reports how it ended.
+static int serveConnection(int connection, const std::function<int(int, const char **)> &handler) {
+    YacRequest request;
+    int fds[3];
+    if (!receiveRequest(connection, request, fds))
+        return 1;
+    // open in the worker only, until it exits (or execs a program)
+    int exited[2];
+    if (pipe(exited) != 0 || fcntl(exited[1], F_SETFD, FD_CLOEXEC) != 0)
+        return 1;
+    auto worker = fork();
+    if (worker == 0) {
+        close(connection);
+        close(exited[0]);
+        for (int i = 0; i < 3; ++i)
+            if (fds[i] != i) {
+                dup2(fds[i], i);
+                close(fds[i]);
+            }
+        // a server started in the background ignores them, yac would not
+        for (int number: {SIGINT, SIGTERM, SIGHUP, SIGQUIT})
+            std::signal(number, SIG_DFL);
+        if (chdir(request.directory.c_str()) != 0)
+            std::_Exit(1);
+        clearenv();
+        // putenv() keeps the strings, which live until exit
+        for (auto &variable: request.environment)
+            putenv(&variable[0]);
+        std::vector<const char *> argv{"yac"};
+        for (auto &arg: request.args)
+            argv.push_back(arg.c_str());
+        // exit() flushes the streams of the request
+        std::exit(handler(static_cast<int>(argv.size()), argv.data()));
+    }
+    for (int i = 0; i < 3; ++i)
+        close(fds[i]);
+    close(exited[1]);
+    if (worker > 0)
+        superviseWorker(connection, worker, exited[0]);
+    close(exited[0]);
+    int status = 1;
+    if (worker > 0) {
+        while (waitpid(worker, &status, 0) < 0 && errno == EINTR);
+        status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    }
+    sendStatus(connection, status);
+    return 0;
+}
+
+int serveRequests(const std::string &path, const std::function<int(int, const char **)> &handler,
+                  std::ostream &diagnostics) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        diagnostics << "yac: socket path `" << path << "' is too long" << std::endl;
+        return 1;
+    }
+    std::strcpy(address.sun_path, path.c_str());
+    // Standard descriptors the server was started without are taken by
+    // /dev/null, so that no descriptor of a request gets their numbers and is
+    // overwritten when the worker installs the streams of the client.
+    for (int i = 0; i < 3; ++i)
+        if (fcntl(i, F_GETFD) < 0 && errno == EBADF)
+            open("/dev/null", O_RDWR);
+    // the socket of a server gone, never any other file
+    struct stat info;
+    if (lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode))
+        unlink(path.c_str());
+    // a request runs anything as the user of the server: the socket is
+    // created for this user alone
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    auto mask = umask(077);
+    bool bound = server >= 0 && bind(server, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+    umask(mask);
+    if (!bound || listen(server, SOMAXCONN) != 0) {
+        diagnostics << "yac: cannot listen on `" << path << "': " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    diagnostics.flush();
+    // the connection processes are reaped by the system
+    std::signal(SIGCHLD, SIG_IGN);
+    for (;;) {
+        int connection = accept(server, nullptr, nullptr);
+        if (connection < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            diagnostics << "yac: accept failed: " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+        // even through a socket made accessible afterwards
+        ucred peer;
+        socklen_t size = sizeof(peer);
+        if (getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &peer, &size) != 0 || peer.uid != getuid()) {
+            diagnostics << "yac: refused a connection from another user" << std::endl;
+            close(connection);
+            continue;
+        }
+        if (fork() == 0) {
+            close(server);
+            // waitpid() needs its children kept
+            std::signal(SIGCHLD, SIG_DFL);
+            std::_Exit(serveConnection(connection, handler));
+        }
+        close(connection);
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef SERVER_H_INCLUDE
+#define SERVER_H_INCLUDE
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include "transport.h"
+
+// Serves requests on the Unix socket `path' until killed. Every request runs
+// `handler' on its command line in a process forked from this one, so what
+// the server initialized before is warm and a crashing program only takes its
+// own process down. The client gets back the exit status, 128 plus the
+// signal number if the process was killed.
+// return 1 if the socket cannot be set up
+int serveRequests(const std::string &path, const std::function<int(int argc, const char **argv)> &handler,
+                  std::ostream &diagnostics);
+
+#endif
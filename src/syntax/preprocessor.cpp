@@ -0,0 +1,1078 @@
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "preprocessor.h"
+
+// C89 as the grammar, on the target of the code generator, x86-64 Linux
+static const char g_predefined[] =
+    "#define __STDC__ 1\n"
+    "#define __STDC_HOSTED__ 1\n"
+    "#define __yac__ 1\n"
+    "#define __x86_64__ 1\n"
+    "#define __x86_64 1\n"
+    "#define __linux__ 1\n"
+    "#define __linux 1\n"
+    "#define __unix__ 1\n"
+    "#define __unix 1\n"
+    "#define __ELF__ 1\n"
+    "#define __LP64__ 1\n"
+    "#define _LP64 1\n"
+    "#define __CHAR_BIT__ 8\n"
+    "#define __SIZEOF_SHORT__ 2\n"
+    "#define __SIZEOF_INT__ 4\n"
+    "#define __SIZEOF_LONG__ 8\n"
+    "#define __SIZEOF_LONG_LONG__ 8\n"
+    "#define __SIZEOF_POINTER__ 8\n"
+    "#define __SCHAR_MAX__ 127\n"
+    "#define __SHRT_MAX__ 32767\n"
+    "#define __INT_MAX__ 2147483647\n"
+    "#define __LONG_MAX__ 9223372036854775807L\n"
+    "#define __SIZE_TYPE__ unsigned long\n"
+    "#define __PTRDIFF_TYPE__ long\n"
+    "#define __WCHAR_TYPE__ int\n"
+    "#define __ORDER_LITTLE_ENDIAN__ 1234\n"
+    "#define __ORDER_BIG_ENDIAN__ 4321\n"
+    "#define __BYTE_ORDER__ __ORDER_LITTLE_ENDIAN__\n";
+
+static const char *const g_system_dirs[] = {
+#ifdef YAC_COMPILER_INCLUDE_DIR
+    YAC_COMPILER_INCLUDE_DIR,
+#endif
+    "/usr/local/include",
+#if defined(__x86_64__) && defined(__linux__)
+    "/usr/include/x86_64-linux-gnu",
+#endif
+    "/usr/include",
+};
+
+// longest first
+static const char *const g_punctuators[] = {
+    "...", "<<=", ">>=",
+    "->", "++", "--", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||",
+    "*=", "/=", "%=", "+=", "-=", "&=", "^=", "|=", "##",
+};
+
+static bool isIdentifierStart(char c) {
+    return isalpha(static_cast<unsigned char>(c)) || c == '_' || c == '$';
+}
+
+static bool isIdentifierChar(char c) {
+    return isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$';
+}
+
+static size_t lexQuoted(llvm::StringRef text, size_t i, YacPPToken::Kind &kind)
+{
+    char quote = text[i++];
+    while (i < text.size() && text[i] != quote && text[i] != '\n') {
+        if (text[i] == '\\' && i + 1 < text.size() && text[i + 1] != '\n')
+            ++i;
+        ++i;
+    }
+    if (i < text.size() && text[i] == quote) {
+        kind = quote == '"' ? YacPPToken::String : YacPPToken::Character;
+        return i + 1;
+    }
+    // unterminated, harmless in skipped groups
+    kind = YacPPToken::Other;
+    return i;
+}
+
+// Lexes the token starting at text[begin], which is not white space.
+// return the end of the token
+static size_t lexToken(llvm::StringRef text, size_t begin, YacPPToken::Kind &kind)
+{
+    size_t i = begin, size = text.size();
+    char c = text[i];
+    if (isIdentifierStart(c)) {
+        while (i < size && isIdentifierChar(text[i]))
+            ++i;
+        auto word = text.slice(begin, i);
+        if (i < size && (text[i] == '"' || text[i] == '\'') && (word == "L" || word == "u" || word == "U" || word == "u8"))
+            return lexQuoted(text, i, kind);
+        kind = YacPPToken::Identifier;
+        return i;
+    }
+    if (isdigit(static_cast<unsigned char>(c)) || (c == '.' && i + 1 < size && isdigit(static_cast<unsigned char>(text[i + 1])))) {
+        // a preprocessing number, e.g. 0x1p-3 or 1e+10
+        for (++i; i < size; ++i) {
+            char prev = text[i - 1];
+            if ((text[i] == '+' || text[i] == '-') && (prev == 'e' || prev == 'E' || prev == 'p' || prev == 'P'))
+                continue;
+            if (!isIdentifierChar(text[i]) && text[i] != '.')
+                break;
+        }
+        kind = YacPPToken::Number;
+        return i;
+    }
+    if (c == '"' || c == '\'')
+        return lexQuoted(text, i, kind);
+    for (auto punctuator: g_punctuators)
+        if (text.substr(i).startswith(punctuator)) {
+            kind = YacPPToken::Punctuator;
+            return i + strlen(punctuator);
+        }
+    kind = ispunct(static_cast<unsigned char>(c)) ? YacPPToken::Punctuator : YacPPToken::Other;
+    return i + 1;
+}
+
+static std::string spell(const YacPPToken *begin, const YacPPToken *end)
+{
+    std::string result;
+    for (auto iter = begin; iter != end; ++iter) {
+        if (iter != begin && iter->space)
+            result += ' ';
+        result += iter->text.str();
+    }
+    return result;
+}
+
+
+YacTokenizedFile::YacTokenizedFile(std::string path, std::unique_ptr<llvm::MemoryBuffer> buffer)
+    : m_path(std::move(path)), m_buffer(std::move(buffer)), m_saver(m_allocator) {
+    tokenize(m_buffer->getBuffer());
+    detectGuard();
+}
+
+YacTokenizedFile::YacTokenizedFile(std::string path, llvm::StringRef text)
+    : m_path(std::move(path)), m_saver(m_allocator) {
+    tokenize(text);
+    detectGuard();
+}
+
+void YacTokenizedFile::tokenize(llvm::StringRef text)
+{
+    // Line splices are removed first. Where they were is remembered to keep
+    // the line numbers right.
+    std::vector<size_t> splices;
+    if (text.find("\\\n") != llvm::StringRef::npos || text.find("\\\r\n") != llvm::StringRef::npos) {
+        std::string clean;
+        clean.reserve(text.size());
+        for (size_t i = 0; i < text.size(); ++i) {
+            if (text[i] == '\\') {
+                size_t j = i + 1;
+                if (j < text.size() && text[j] == '\r')
+                    ++j;
+                if (j < text.size() && text[j] == '\n') {
+                    splices.push_back(clean.size());
+                    i = j;
+                    continue;
+                }
+            }
+            clean.push_back(text[i]);
+        }
+        text = m_saver.save(clean);
+    }
+
+    m_tokens.reserve(text.size() / 4);
+    size_t next_splice = 0;
+    uint32_t line = 1;
+    Line current{line, 0, 0, false};
+    bool first = true, space = false;
+    auto finish = [&]() {
+        current.end = static_cast<uint32_t>(m_tokens.size());
+        if (current.directive || current.begin != current.end)
+            m_lines.push_back(current);
+    };
+    size_t i = 0, size = text.size();
+    while (i < size) {
+        for (; next_splice < splices.size() && splices[next_splice] <= i; ++next_splice)
+            ++line;
+        char c = text[i];
+        if (c == '\n') {
+            finish();
+            ++i;
+            ++line;
+            current = Line{line, static_cast<uint32_t>(m_tokens.size()), 0, false};
+            first = true;
+            space = false;
+        } else if (c == ' ' || c == '\t' || c == '\f' || c == '\v' || c == '\r') {
+            space = true;
+            ++i;
+        } else if (c == '/' && i + 1 < size && text[i + 1] == '*') {
+            size_t end = text.find("*/", i + 2);
+            end = end == llvm::StringRef::npos ? size : end + 2;
+            line += static_cast<uint32_t>(text.slice(i, end).count('\n'));
+            space = true;
+            i = end;
+        } else if (c == '/' && i + 1 < size && text[i + 1] == '/') {
+            i = std::min(text.find('\n', i), size);
+        } else if (first && c == '#') {
+            current.directive = true;
+            first = false;
+            space = false;
+            ++i;
+        } else {
+            YacPPToken token;
+            size_t end = lexToken(text, i, token.kind);
+            token.text = text.slice(i, end);
+            token.line = line;
+            token.space = space;
+            m_tokens.push_back(token);
+            first = space = false;
+            i = end;
+        }
+    }
+    finish();
+}
+
+void YacTokenizedFile::detectGuard()
+{
+    if (m_lines.empty() || !m_lines.front().directive)
+        return;
+    auto &first = m_lines.front();
+    const YacPPToken *tokens = m_tokens.data() + first.begin;
+    size_t count = first.end - first.begin;
+    llvm::StringRef guard;
+    if (count == 2 && tokens[0].text == "ifndef" && tokens[1].kind == YacPPToken::Identifier)
+        guard = tokens[1].text;
+    else if (count >= 4 && tokens[0].text == "if" && tokens[1].is("!") && tokens[2].text == "defined") {
+        if (count == 4 && tokens[3].kind == YacPPToken::Identifier)
+            guard = tokens[3].text;
+        else if (count == 6 && tokens[3].is("(") && tokens[4].kind == YacPPToken::Identifier && tokens[5].is(")"))
+            guard = tokens[4].text;
+    }
+    if (guard.empty())
+        return;
+    // the matching #endif must be the last line, with no #else or #elif at
+    // the outermost level
+    int depth = 0;
+    for (size_t i = 0; i < m_lines.size(); ++i) {
+        auto &line = m_lines[i];
+        if (!line.directive || line.begin == line.end)
+            continue;
+        auto name = m_tokens[line.begin].text;
+        if (name == "if" || name == "ifdef" || name == "ifndef")
+            ++depth;
+        else if (depth == 1 && (name == "else" || name == "elif"))
+            return;
+        else if (name == "endif" && --depth == 0) {
+            if (i + 1 == m_lines.size())
+                m_guard = guard;
+            return;
+        }
+    }
+}
+
+
+YacHeaderCache &YacHeaderCache::global()
+{
+    static YacHeaderCache cache;
+    return cache;
+}
+
+std::shared_ptr<const YacTokenizedFile> YacHeaderCache::get(const std::string &path)
+{
+    llvm::sys::fs::file_status status;
+    if (llvm::sys::fs::status(path, status) || !llvm::sys::fs::is_regular_file(status))
+        return nullptr;
+    uint64_t size = status.getSize();
+    int64_t modification = status.getLastModificationTime().time_since_epoch().count();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto iter = m_entries.find(path);
+        if (iter != m_entries.end() && iter->second.size == size && iter->second.modification == modification)
+            return iter->second.file;
+    }
+    // tokenized without the lock, another thread may be doing the same
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer)
+        return nullptr;
+    std::shared_ptr<const YacTokenizedFile> file = std::make_shared<YacTokenizedFile>(path, std::move(*buffer));
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries[path] = Entry{file, size, modification};
+    return file;
+}
+
+
+// #if expressions, evaluated in intmax_t
+class YacPPExpression {
+public:
+    explicit YacPPExpression(const std::vector<YacPPToken> &tokens)
+        : m_tokens(tokens), m_pos(0), m_unevaluated(0) {}
+
+    // return false on error
+    bool parse(int64_t &value) {
+        if (m_tokens.empty())
+            fail("#if with no expression");
+        value = conditional();
+        if (m_pos != m_tokens.size())
+            fail("missing binary operator before token \"" + m_tokens[m_pos].text.str() + "\"");
+        return m_error.empty();
+    }
+    const std::string &error() const {
+        return m_error;
+    }
+private:
+    bool accept(llvm::StringRef punctuator) {
+        if (m_pos < m_tokens.size() && m_tokens[m_pos].is(punctuator)) {
+            ++m_pos;
+            return true;
+        }
+        return false;
+    }
+    int64_t fail(const std::string &message) {
+        if (m_error.empty())
+            m_error = message;
+        m_pos = m_tokens.size();
+        return 0;
+    }
+
+    int64_t conditional() {
+        auto condition = binary(0);
+        if (!accept("?"))
+            return condition;
+        m_unevaluated += !condition;
+        auto left = conditional();
+        m_unevaluated -= !condition;
+        if (!accept(":"))
+            return fail("expected ':' in conditional expression");
+        m_unevaluated += !!condition;
+        auto right = conditional();
+        m_unevaluated -= !!condition;
+        return condition ? left : right;
+    }
+
+    // binary operators by increasing precedence
+    int64_t binary(int level) {
+        static const char *const levels[][4] = {
+            {"||"}, {"&&"}, {"|"}, {"^"}, {"&"}, {"==", "!="}, {"<", ">", "<=", ">="}, {"<<", ">>"}, {"+", "-"}, {"*", "/", "%"},
+        };
+        if (level == sizeof(levels) / sizeof(levels[0]))
+            return unary();
+        auto value = binary(level + 1);
+        for (;;) {
+            llvm::StringRef op;
+            for (auto candidate: levels[level])
+                if (candidate && accept(candidate)) {
+                    op = candidate;
+                    break;
+                }
+            if (op.empty())
+                return value;
+            // the right operand of a short-circuited && or || is not evaluated
+            bool skip = (op == "&&" && !value) || (op == "||" && value);
+            m_unevaluated += skip;
+            auto right = binary(level + 1);
+            m_unevaluated -= skip;
+            value = apply(op, value, right);
+        }
+    }
+
+    int64_t apply(llvm::StringRef op, int64_t left, int64_t right) {
+        if (op == "||") return left || right;
+        if (op == "&&") return left && right;
+        if (op == "|") return left | right;
+        if (op == "^") return left ^ right;
+        if (op == "&") return left & right;
+        if (op == "==") return left == right;
+        if (op == "!=") return left != right;
+        if (op == "<") return left < right;
+        if (op == ">") return left > right;
+        if (op == "<=") return left <= right;
+        if (op == ">=") return left >= right;
+        if (op == "<<") return right >= 64 || right < 0 ? 0 : static_cast<int64_t>(static_cast<uint64_t>(left) << right);
+        if (op == ">>") return right >= 64 || right < 0 ? (left < 0 ? -1 : 0) : left >> right;
+        if (op == "+") return static_cast<int64_t>(static_cast<uint64_t>(left) + static_cast<uint64_t>(right));
+        if (op == "-") return static_cast<int64_t>(static_cast<uint64_t>(left) - static_cast<uint64_t>(right));
+        if (op == "*") return static_cast<int64_t>(static_cast<uint64_t>(left) * static_cast<uint64_t>(right));
+        if (right == 0)
+            return m_unevaluated ? 0 : fail("division by zero in #if");
+        if (right == -1)
+            return op == "/" ? static_cast<int64_t>(0 - static_cast<uint64_t>(left)) : 0;
+        return op == "/" ? left / right : left % right;
+    }
+
+    int64_t unary() {
+        if (accept("+"))
+            return unary();
+        if (accept("-"))
+            return static_cast<int64_t>(0 - static_cast<uint64_t>(unary()));
+        if (accept("~"))
+            return ~unary();
+        if (accept("!"))
+            return !unary();
+        if (accept("(")) {
+            auto value = conditional();
+            if (!accept(")"))
+                return fail("missing ')' in expression");
+            return value;
+        }
+        if (m_pos == m_tokens.size())
+            return fail("#if with no expression");
+        auto &token = m_tokens[m_pos++];
+        switch (token.kind) {
+            case YacPPToken::Number:
+                return number(token.text);
+            case YacPPToken::Character:
+                return character(token.text);
+            case YacPPToken::Identifier:
+                // identifiers left after macro expansion
+                return 0;
+            default:
+                return fail("token \"" + token.text.str() + "\" is not valid in preprocessor expressions");
+        }
+    }
+
+    int64_t number(llvm::StringRef text) {
+        auto digits = text.rtrim("uUlL").str();
+        char *end;
+        auto value = strtoull(digits.c_str(), &end, 0);
+        if (*end != '\0')
+            return fail("invalid integer constant \"" + text.str() + "\" in #if");
+        return static_cast<int64_t>(value);
+    }
+
+    int64_t character(llvm::StringRef text) {
+        text = text.substr(text.find('\'') + 1).drop_back();
+        if (text.empty())
+            return fail("empty character constant");
+        if (text[0] != '\\')
+            return static_cast<signed char>(text[0]);
+        if (text.size() < 2)
+            return fail("invalid escape sequence");
+        switch (text[1]) {
+            case 'a': return '\a';
+            case 'b': return '\b';
+            case 'f': return '\f';
+            case 'n': return '\n';
+            case 'r': return '\r';
+            case 't': return '\t';
+            case 'v': return '\v';
+            case 'x':
+                return static_cast<signed char>(strtol(text.substr(2).str().c_str(), nullptr, 16));
+            default:
+                if ('0' <= text[1] && text[1] <= '7')
+                    return static_cast<signed char>(strtol(text.substr(1).str().c_str(), nullptr, 8));
+                return text[1];
+        }
+    }
+
+    const std::vector<YacPPToken> &m_tokens;
+    size_t m_pos;
+    int m_unevaluated;
+    std::string m_error;
+};
+
+
+YacPreprocessor::YacPreprocessor(const YacPreprocessorOptions &options, std::ostream &diagnostics)
+    : m_dirs(options.include_dirs), m_predefined(g_predefined), m_diagnostics(diagnostics), m_failed(false),
+      m_isolated(false), m_saver(m_allocator), m_out_file(UINT32_MAX), m_out_line(0), m_line_start(true) {
+    m_dirs.insert(m_dirs.end(), std::begin(g_system_dirs), std::end(g_system_dirs));
+    for (auto &define: options.defines) {
+        auto equal = define.find('=');
+        if (equal == std::string::npos)
+            m_predefined += "#define " + define + " 1\n";
+        else
+            m_predefined += "#define " + define.substr(0, equal) + ' ' + define.substr(equal + 1) + '\n';
+    }
+    m_macros["__FILE__"].builtin = Macro::File;
+    m_macros["__LINE__"].builtin = Macro::Line;
+}
+
+bool YacPreprocessor::run(llvm::StringRef name, llvm::StringRef text, llvm::raw_ostream &out)
+{
+    push(std::make_shared<YacTokenizedFile>(name.str(), text), -1);
+    // the predefined macros are defined before the first line of the main file
+    push(std::make_shared<YacTokenizedFile>("<built-in>", llvm::StringRef(m_predefined)), -1);
+    YacPPToken token;
+    while (expandNext(token))
+        write(token, out);
+    if (!m_line_start)
+        out << '\n';
+    return !m_failed;
+}
+
+uint32_t YacPreprocessor::addName(llvm::StringRef name)
+{
+    auto iter = m_name_indices.insert(std::make_pair(name, static_cast<uint32_t>(m_names.size())));
+    if (iter.second)
+        m_names.push_back(name.str());
+    return iter.first->getValue();
+}
+
+void YacPreprocessor::push(std::shared_ptr<const YacTokenizedFile> file, int dir)
+{
+    Frame frame;
+    frame.name = addName(file->path());
+    frame.line_delta = 0;
+    frame.dir = dir;
+    frame.line = frame.token = frame.token_end = 0;
+    frame.file = file;
+    m_files.push_back(std::move(file));
+    m_frames.push_back(std::move(frame));
+}
+
+bool YacPreprocessor::next(YacPPToken &token)
+{
+    while (!m_frames.empty()) {
+        auto &frame = m_frames.back();
+        if (frame.token < frame.token_end) {
+            token = frame.file->tokens()[frame.token++];
+            token.file = frame.name;
+            token.line += frame.line_delta;
+            return true;
+        }
+        auto &lines = frame.file->lines();
+        if (frame.line == lines.size()) {
+            if (!frame.conditionals.empty())
+                error(frame.name, lines.back().line + frame.line_delta, "unterminated conditional directive");
+            m_frames.pop_back();
+            continue;
+        }
+        auto &line = lines[frame.line++];
+        if (line.directive)
+            directive(line);
+        else if (frame.active()) {
+            frame.token = line.begin;
+            frame.token_end = line.end;
+        }
+    }
+    return false;
+}
+
+bool YacPreprocessor::get(YacPPToken &token)
+{
+    if (!m_pending.empty()) {
+        token = m_pending.back();
+        m_pending.pop_back();
+        return true;
+    }
+    return !m_isolated && next(token);
+}
+
+bool YacPreprocessor::expandNext(YacPPToken &token)
+{
+    while (get(token)) {
+        if (token.kind == YacPPToken::EndMacro) {
+            m_disabled.erase(token.text);
+            continue;
+        }
+        if (token.kind != YacPPToken::Identifier || token.noexpand)
+            return true;
+        auto iter = m_macros.find(token.text);
+        if (iter == m_macros.end())
+            return true;
+        if (m_disabled.count(token.text)) {
+            token.noexpand = true;
+            return true;
+        }
+        if (!expandMacro(token, iter->second))
+            return true;
+    }
+    return false;
+}
+
+YacPreprocessor::Tokens YacPreprocessor::expand(const Tokens &tokens)
+{
+    Tokens pending(tokens.rbegin(), tokens.rend()), result;
+    std::swap(pending, m_pending);
+    bool isolated = m_isolated;
+    m_isolated = true;
+    YacPPToken token;
+    while (expandNext(token))
+        result.push_back(token);
+    m_isolated = isolated;
+    std::swap(pending, m_pending);
+    return result;
+}
+
+// Pushes the expansion of `macro' invoked by `name' back to the input for
+// rescanning.
+// return false if `name' does not invoke the macro
+bool YacPreprocessor::expandMacro(const YacPPToken &name, Macro &macro)
+{
+    if (macro.builtin != Macro::None) {
+        YacPPToken token = name;
+        if (macro.builtin == Macro::File) {
+            std::string text = "\"";
+            for (char c: m_names[name.file]) {
+                if (c == '"' || c == '\\')
+                    text += '\\';
+                text += c;
+            }
+            token.kind = YacPPToken::String;
+            token.text = m_saver.save(text + '"');
+        } else {
+            token.kind = YacPPToken::Number;
+            token.text = m_saver.save(std::to_string(name.line));
+        }
+        unget(token);
+        return true;
+    }
+
+    std::vector<Tokens> args;
+    if (macro.function) {
+        // a function-like macro name not followed by `(' is left alone, the
+        // macro expansions ending in between still end
+        Tokens ended;
+        YacPPToken token;
+        bool invoked = false;
+        while (get(token)) {
+            if (token.kind == YacPPToken::EndMacro) {
+                ended.push_back(token);
+                continue;
+            }
+            invoked = token.is("(");
+            if (!invoked)
+                unget(token);
+            break;
+        }
+        if (!invoked) {
+            for (auto iter = ended.rbegin(); iter != ended.rend(); ++iter)
+                unget(*iter);
+            return false;
+        }
+        for (auto &marker: ended)
+            m_disabled.erase(marker.text);
+
+        int depth = 0;
+        args.emplace_back();
+        for (;;) {
+            if (!get(token)) {
+                error(name, "unterminated argument list invoking macro \"" + name.text.str() + '"');
+                return true;
+            }
+            if (token.kind == YacPPToken::EndMacro) {
+                m_disabled.erase(token.text);
+                continue;
+            }
+            if (token.is("("))
+                ++depth;
+            else if (token.is(")") && depth-- == 0)
+                break;
+            else if (token.is(",") && depth == 0 && !(macro.variadic && args.size() == macro.params.size())) {
+                args.emplace_back();
+                continue;
+            }
+            args.back().push_back(token);
+        }
+        if (macro.params.empty() && args.size() == 1 && args[0].empty())
+            args.clear();
+        if (macro.variadic && args.size() + 1 == macro.params.size())
+            args.emplace_back();
+        if (args.size() != macro.params.size()) {
+            error(name, "macro \"" + name.text.str() + "\" requires " + std::to_string(macro.params.size()) +
+                        " arguments, but " + std::to_string(args.size()) + " given");
+            return true;
+        }
+    }
+
+    auto result = substitute(macro, args);
+    for (auto &token: result) {
+        token.line = name.line;
+        token.file = name.file;
+    }
+    if (!result.empty())
+        result.front().space = name.space;
+    YacPPToken end = name;
+    end.kind = YacPPToken::EndMacro;
+    unget(end);
+    for (auto iter = result.rbegin(); iter != result.rend(); ++iter)
+        unget(*iter);
+    m_disabled.insert(name.text);
+    return true;
+}
+
+YacPreprocessor::Tokens YacPreprocessor::substitute(const Macro &macro, const std::vector<Tokens> &args)
+{
+    auto param = [&macro](const YacPPToken &token) -> int {
+        if (token.kind != YacPPToken::Identifier)
+            return -1;
+        for (size_t i = 0; i < macro.params.size(); ++i)
+            if (macro.params[i] == token.text)
+                return static_cast<int>(i);
+        return -1;
+    };
+    Tokens result;
+    auto &body = macro.body;
+    // the left operand of a following ## is an empty argument
+    bool empty_left = false;
+    for (size_t i = 0; i < body.size(); ++i) {
+        auto &token = body[i];
+        if (macro.function && token.is("#") && i + 1 < body.size() && param(body[i + 1]) >= 0) {
+            result.push_back(stringize(args[param(body[++i])]));
+            result.back().space = token.space;
+            empty_left = false;
+            continue;
+        }
+        if (token.is("##") && i + 1 < body.size()) {
+            auto &right = body[++i];
+            int index = param(right);
+            if (index < 0) {
+                if (empty_left || result.empty())
+                    result.push_back(right);
+                else
+                    paste(result, right);
+                empty_left = false;
+                continue;
+            }
+            auto &arg = args[index];
+            if (macro.variadic && index + 1 == static_cast<int>(macro.params.size()) && arg.empty() &&
+                !empty_left && !result.empty() && result.back().is(",")) {
+                // `, ## __VA_ARGS__' drops the comma if there are no variable arguments
+                result.pop_back();
+                empty_left = false;
+            } else if (!arg.empty()) {
+                size_t first = 0;
+                bool gnu_comma = macro.variadic && index + 1 == static_cast<int>(macro.params.size()) &&
+                                 !result.empty() && result.back().is(",");
+                if (!empty_left && !result.empty() && !gnu_comma)
+                    paste(result, arg[first++]);
+                result.insert(result.end(), arg.begin() + first, arg.end());
+                empty_left = false;
+            }
+            continue;
+        }
+        int index = param(token);
+        if (index < 0) {
+            result.push_back(token);
+            empty_left = false;
+            continue;
+        }
+        // operands of ## are not expanded
+        bool pasted = i + 1 < body.size() && body[i + 1].is("##");
+        auto arg = pasted ? args[index] : expand(args[index]);
+        if (!arg.empty())
+            arg.front().space = token.space;
+        result.insert(result.end(), arg.begin(), arg.end());
+        empty_left = args[index].empty();
+    }
+    return result;
+}
+
+YacPPToken YacPreprocessor::stringize(const Tokens &tokens)
+{
+    std::string text = "\"";
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        if (i && tokens[i].space)
+            text += ' ';
+        bool quoted = tokens[i].kind == YacPPToken::String || tokens[i].kind == YacPPToken::Character;
+        for (char c: tokens[i].text) {
+            if (quoted && (c == '"' || c == '\\'))
+                text += '\\';
+            text += c;
+        }
+    }
+    text += '"';
+    YacPPToken token;
+    token.kind = YacPPToken::String;
+    token.text = m_saver.save(text);
+    return token;
+}
+
+void YacPreprocessor::paste(Tokens &result, const YacPPToken &right)
+{
+    auto &left = result.back();
+    std::string text = left.text.str() + right.text.str();
+    YacPPToken::Kind kind;
+    if (lexToken(text, 0, kind) != text.size()) {
+        error(left, "pasting \"" + left.text.str() + "\" and \"" + right.text.str() +
+                    "\" does not give a valid preprocessing token");
+        result.push_back(right);
+        return;
+    }
+    left.text = m_saver.save(text);
+    left.kind = kind;
+    left.noexpand = false;
+}
+
+void YacPreprocessor::directive(const YacTokenizedFile::Line &line)
+{
+    auto &frame = m_frames.back();
+    auto begin = frame.file->tokens().data() + line.begin, end = frame.file->tokens().data() + line.end;
+    uint32_t file = frame.name, number = line.line + frame.line_delta;
+    if (begin == end)
+        return;
+    auto name = begin->text;
+    auto &conditionals = frame.conditionals;
+    if (name == "if" || name == "ifdef" || name == "ifndef") {
+        Conditional conditional{false, true, false};
+        if (frame.active()) {
+            if (name == "if")
+                conditional.active = evaluate(begin + 1, end, number);
+            else if (begin + 1 == end || begin[1].kind != YacPPToken::Identifier)
+                error(file, number, "macro names must be identifiers");
+            else
+                conditional.active = (m_macros.count(begin[1].text) != 0) == (name == "ifdef");
+            conditional.taken = conditional.active;
+        }
+        conditionals.push_back(conditional);
+        return;
+    }
+    if (name == "elif" || name == "else") {
+        if (conditionals.empty() || conditionals.back().has_else) {
+            error(file, number, '#' + name.str() + " without #if");
+            return;
+        }
+        auto &conditional = conditionals.back();
+        if (conditional.taken)
+            conditional.active = false;
+        else {
+            conditional.active = name == "else" || evaluate(begin + 1, end, number);
+            conditional.taken = conditional.active;
+        }
+        conditional.has_else = name == "else";
+        return;
+    }
+    if (name == "endif") {
+        if (conditionals.empty())
+            error(file, number, "#endif without #if");
+        else
+            conditionals.pop_back();
+        return;
+    }
+    if (!frame.active())
+        return;
+
+    if (name == "define")
+        define(begin + 1, end, number);
+    else if (name == "undef") {
+        if (begin + 1 == end || begin[1].kind != YacPPToken::Identifier)
+            error(file, number, "macro names must be identifiers");
+        else
+            m_macros.erase(begin[1].text);
+    } else if (name == "include" || name == "include_next")
+        include(begin + 1, end, number, name == "include_next");
+    else if (name == "line" || begin->kind == YacPPToken::Number) {
+        // `#line 12 "file"' or the line marker `# 12 "file" 1'
+        auto tokens = begin->kind == YacPPToken::Number ? Tokens(begin, end) : expand(Tokens(begin + 1, end));
+        if (tokens.empty() || tokens[0].kind != YacPPToken::Number) {
+            error(file, number, "#line directive requires a simple digit sequence");
+            return;
+        }
+        auto value = strtoul(tokens[0].text.str().c_str(), nullptr, 10);
+        // the line following the directive gets number `value'
+        frame.line_delta = static_cast<int32_t>(value) - static_cast<int32_t>(line.line + 1);
+        if (tokens.size() > 1 && tokens[1].kind == YacPPToken::String) {
+            std::string path;
+            auto text = tokens[1].text.drop_front().drop_back();
+            for (size_t i = 0; i < text.size(); ++i) {
+                if (text[i] == '\\' && i + 1 < text.size())
+                    ++i;
+                path += text[i];
+            }
+            frame.name = addName(path);
+        }
+    } else if (name == "error")
+        error(file, number, "#error " + spell(begin + 1, end));
+    else if (name == "warning")
+        m_diagnostics << "yac: " << m_names[file] << ':' << number << ": preprocessor warning: #warning "
+                      << spell(begin + 1, end) << std::endl;
+    else if (name == "pragma") {
+        if (begin + 1 != end && begin[1].text == "once")
+            m_once.insert(frame.file->path());
+    } else if (name != "ident" && name != "sccs")
+        error(file, number, "invalid preprocessing directive #" + name.str());
+}
+
+void YacPreprocessor::define(const YacPPToken *begin, const YacPPToken *end, uint32_t line)
+{
+    uint32_t file = m_frames.back().name;
+    if (begin == end || begin->kind != YacPPToken::Identifier) {
+        error(file, line, "macro names must be identifiers");
+        return;
+    }
+    if (begin->text == "defined") {
+        error(file, line, "\"defined\" cannot be used as a macro name");
+        return;
+    }
+    Macro macro;
+    auto name = begin++->text;
+    if (begin != end && begin->is("(") && !begin->space) {
+        macro.function = true;
+        bool closed = ++begin != end && begin->is(")");
+        if (closed)
+            ++begin;
+        while (!closed) {
+            if (begin != end && begin->is("...")) {
+                macro.variadic = true;
+                macro.params.push_back("__VA_ARGS__");
+                ++begin;
+            } else if (begin != end && begin->kind == YacPPToken::Identifier)
+                macro.params.push_back(begin++->text);
+            else {
+                error(file, line, "expected parameter name in macro parameter list");
+                return;
+            }
+            if (begin != end && begin->is(")")) {
+                ++begin;
+                closed = true;
+                continue;
+            }
+            if (macro.variadic || begin == end || !begin->is(",")) {
+                error(file, line, "expected ')' in macro parameter list");
+                return;
+            }
+            ++begin;
+        }
+    }
+    macro.body.assign(begin, end);
+    if (!macro.body.empty()) {
+        macro.body.front().space = false;
+        if (macro.body.front().is("##") || macro.body.back().is("##")) {
+            error(file, line, "'##' cannot appear at either end of a macro expansion");
+            return;
+        }
+    }
+    m_macros[name] = std::move(macro);
+}
+
+void YacPreprocessor::include(const YacPPToken *begin, const YacPPToken *end, uint32_t line, bool next)
+{
+    uint32_t file = m_frames.back().name;
+    Tokens expanded;
+    if (begin != end && begin->kind != YacPPToken::String && !begin->is("<")) {
+        // #include MACRO
+        expanded = expand(Tokens(begin, end));
+        begin = expanded.data();
+        end = begin + expanded.size();
+    }
+    std::string header;
+    bool quoted = begin != end && begin->kind == YacPPToken::String && begin->text.startswith("\"");
+    if (quoted)
+        header = begin->text.drop_front().drop_back().str();
+    else if (begin != end && begin->is("<")) {
+        for (++begin; begin != end && !begin->is(">"); ++begin) {
+            if (begin->space && !header.empty())
+                header += ' ';
+            header += begin->text.str();
+        }
+        if (begin == end) {
+            error(file, line, "missing terminating > character");
+            return;
+        }
+    } else {
+        error(file, line, "#include expects \"FILENAME\" or <FILENAME>");
+        return;
+    }
+    if (m_frames.size() >= 200) {
+        error(file, line, "#include nested too deeply");
+        return;
+    }
+    int dir;
+    auto path = findInclude(header, quoted, next, dir);
+    if (path.empty()) {
+        error(file, line, header + ": No such file or directory");
+        return;
+    }
+    if (m_once.count(path))
+        return;
+    auto header_file = YacHeaderCache::global().get(path);
+    if (!header_file) {
+        error(file, line, "cannot read " + path);
+        return;
+    }
+    // a guarded header included again is not even entered
+    if (!header_file->guard().empty() && m_macros.count(header_file->guard()))
+        return;
+    push(std::move(header_file), dir);
+}
+
+std::string YacPreprocessor::findInclude(llvm::StringRef name, bool quoted, bool next, int &dir)
+{
+    dir = -1;
+    if (llvm::sys::path::is_absolute(name))
+        return llvm::sys::fs::exists(name) ? name.str() : std::string();
+    auto &frame = m_frames.back();
+    if (quoted && !next) {
+        // the directory of the including file comes first
+        llvm::SmallString<256> path(llvm::sys::path::parent_path(frame.file->path()));
+        llvm::sys::path::append(path, name);
+        if (llvm::sys::fs::exists(path)) {
+            dir = frame.dir;
+            return path.str().str();
+        }
+    }
+    // #include_next continues after the directory of the current file
+    size_t first = next && frame.dir >= 0 ? static_cast<size_t>(frame.dir) + 1 : 0;
+    for (size_t i = first; i < m_dirs.size(); ++i) {
+        llvm::SmallString<256> path(m_dirs[i]);
+        llvm::sys::path::append(path, name);
+        if (llvm::sys::fs::exists(path)) {
+            dir = static_cast<int>(i);
+            return path.str().str();
+        }
+    }
+    return std::string();
+}
+
+bool YacPreprocessor::evaluate(const YacPPToken *begin, const YacPPToken *end, uint32_t line)
+{
+    uint32_t file = m_frames.back().name;
+    // `defined' is replaced before macro expansion
+    Tokens tokens;
+    for (auto iter = begin; iter != end; ++iter) {
+        if (iter->kind != YacPPToken::Identifier || iter->text != "defined") {
+            tokens.push_back(*iter);
+            continue;
+        }
+        bool paren = iter + 1 != end && iter[1].is("(");
+        auto name = iter + (paren ? 2 : 1);
+        if (name >= end || name->kind != YacPPToken::Identifier || (paren && (name + 1 == end || !name[1].is(")")))) {
+            error(file, line, "operator \"defined\" requires an identifier");
+            return false;
+        }
+        YacPPToken value = *iter;
+        value.kind = YacPPToken::Number;
+        value.text = m_macros.count(name->text) ? "1" : "0";
+        tokens.push_back(value);
+        iter = name + (paren ? 1 : 0);
+    }
+    tokens = expand(tokens);
+    YacPPExpression expression(tokens);
+    int64_t value;
+    if (!expression.parse(value)) {
+        error(file, line, expression.error());
+        return false;
+    }
+    return value != 0;
+}
+
+static bool needsSpace(const YacPPToken &left, const YacPPToken &right)
+{
+    bool left_word = left.kind == YacPPToken::Identifier || left.kind == YacPPToken::Number;
+    bool right_word = right.kind == YacPPToken::Identifier || right.kind == YacPPToken::Number;
+    if (left_word)
+        return right_word || right.kind == YacPPToken::String || right.kind == YacPPToken::Character ||
+               (left.kind == YacPPToken::Number && (right.is(".") || right.is("+") || right.is("-")));
+    return left.kind == YacPPToken::Punctuator && right.kind == YacPPToken::Punctuator;
+}
+
+void YacPreprocessor::write(const YacPPToken &token, llvm::raw_ostream &out)
+{
+    // a line marker when the file changes or lines are skipped, newlines
+    // otherwise
+    if (token.file != m_out_file || token.line < m_out_line || token.line > m_out_line + 8) {
+        if (!m_line_start)
+            out << '\n';
+        out << "# " << token.line << " \"";
+        for (char c: m_names[token.file]) {
+            if (c == '"' || c == '\\')
+                out << '\\';
+            out << c;
+        }
+        out << "\"\n";
+        m_out_file = token.file;
+        m_out_line = token.line;
+        m_line_start = true;
+    }
+    for (; m_out_line < token.line; ++m_out_line) {
+        out << '\n';
+        m_line_start = true;
+    }
+    if (!m_line_start && (token.space || needsSpace(m_previous, token)))
+        out << ' ';
+    out << token.text;
+    m_line_start = false;
+    m_previous = token;
+}
+
+void YacPreprocessor::error(uint32_t file, uint32_t line, const std::string &message)
+{
+    m_diagnostics << "yac: " << m_names[file] << ':' << line << ": preprocessor error: " << message << std::endl;
+    m_failed = true;
+}
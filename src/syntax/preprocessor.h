@@ -0,0 +1,200 @@
+#ifndef PREPROCESSOR_H_INCLUDE
+#define PREPROCESSOR_H_INCLUDE
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Support/Allocator.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/StringSaver.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct YacPPToken {
+    enum Kind: uint8_t {
+        Identifier,
+        Number,
+        Character,
+        String,
+        Punctuator,
+        Other,
+        EndMacro,   // end of the expansion of the macro named `text'
+    };
+    llvm::StringRef text;
+    uint32_t line = 0;
+    uint32_t file = 0;      // index into the file names of the preprocessor
+    Kind kind = Other;
+    bool space = false;     // preceded by white space
+    bool noexpand = false;  // names a macro that must not be expanded again
+
+    bool is(llvm::StringRef punctuator) const {
+        return kind == Punctuator && text == punctuator;
+    }
+};
+
+// A source file split into preprocessing tokens, once for all the translation
+// units including it. It is never modified after construction, so it can be
+// shared between threads.
+class YacTokenizedFile {
+public:
+    // a logical line, the `#' of a directive is not part of its tokens
+    struct Line {
+        uint32_t line;
+        uint32_t begin, end;  // range of tokens()
+        bool directive;
+    };
+
+    YacTokenizedFile(std::string path, std::unique_ptr<llvm::MemoryBuffer> buffer);
+    // `text' must outlive the object
+    YacTokenizedFile(std::string path, llvm::StringRef text);
+    YacTokenizedFile(const YacTokenizedFile &) = delete;
+    YacTokenizedFile &operator = (const YacTokenizedFile &) = delete;
+
+    const std::string &path() const {
+        return m_path;
+    }
+    const std::vector<YacPPToken> &tokens() const {
+        return m_tokens;
+    }
+    const std::vector<Line> &lines() const {
+        return m_lines;
+    }
+    // the macro guarding the whole file as in `#ifndef X ... #endif', if any
+    llvm::StringRef guard() const {
+        return m_guard;
+    }
+private:
+    void tokenize(llvm::StringRef text);
+    void detectGuard();
+
+    std::string m_path;
+    std::unique_ptr<llvm::MemoryBuffer> m_buffer;
+    llvm::BumpPtrAllocator m_allocator;
+    llvm::StringSaver m_saver;
+    std::vector<YacPPToken> m_tokens;
+    std::vector<Line> m_lines;
+    llvm::StringRef m_guard;
+};
+
+// Tokenized headers shared by all the preprocessors of the process. A header
+// is read again only when its size or modification time changes.
+class YacHeaderCache {
+public:
+    static YacHeaderCache &global();
+
+    // return nullptr if `path' cannot be read
+    std::shared_ptr<const YacTokenizedFile> get(const std::string &path);
+private:
+    struct Entry {
+        std::shared_ptr<const YacTokenizedFile> file;
+        uint64_t size;
+        int64_t modification;
+    };
+    std::mutex m_mutex;
+    llvm::StringMap<Entry> m_entries;
+};
+
+struct YacPreprocessorOptions {
+    // searched for both "" and <> includes, before the system directories
+    std::vector<std::string> include_dirs;
+    // "NAME" or "NAME=VALUE"
+    std::vector<std::string> defines;
+};
+
+// Expands #include, #define, conditionals etc. of one translation unit. The
+// output keeps `# 12 "stdio.h"' line markers so that the source manager maps
+// diagnostics back to the original files.
+class YacPreprocessor {
+public:
+    YacPreprocessor(const YacPreprocessorOptions &options, std::ostream &diagnostics);
+
+    // return false on error
+    bool run(llvm::StringRef name, llvm::StringRef text, llvm::raw_ostream &out);
+private:
+    struct Macro {
+        enum Builtin { None, File, Line };
+        std::vector<llvm::StringRef> params;
+        std::vector<YacPPToken> body;
+        bool function = false;
+        bool variadic = false;
+        Builtin builtin = None;
+    };
+    struct Conditional {
+        bool active;    // the current group is being processed
+        bool taken;     // a group has been or cannot be processed
+        bool has_else;
+    };
+    struct Frame {
+        std::shared_ptr<const YacTokenizedFile> file;
+        uint32_t name;
+        int32_t line_delta;
+        int dir;        // search directory the file has been found in
+        size_t line, token, token_end;
+        std::vector<Conditional> conditionals;
+
+        bool active() const {
+            return conditionals.empty() || conditionals.back().active;
+        }
+    };
+    typedef std::vector<YacPPToken> Tokens;
+
+    uint32_t addName(llvm::StringRef name);
+    void push(std::shared_ptr<const YacTokenizedFile> file, int dir);
+
+    // token after directives and skipped groups, false at end of input
+    bool next(YacPPToken &token);
+    bool get(YacPPToken &token);
+    void unget(const YacPPToken &token) {
+        m_pending.push_back(token);
+    }
+    // fully macro-expanded token, false at end of input
+    bool expandNext(YacPPToken &token);
+    Tokens expand(const Tokens &tokens);
+    bool expandMacro(const YacPPToken &name, Macro &macro);
+    Tokens substitute(const Macro &macro, const std::vector<Tokens> &args);
+    YacPPToken stringize(const Tokens &tokens);
+    void paste(Tokens &result, const YacPPToken &right);
+
+    void directive(const YacTokenizedFile::Line &line);
+    void define(const YacPPToken *begin, const YacPPToken *end, uint32_t line);
+    void include(const YacPPToken *begin, const YacPPToken *end, uint32_t line, bool next);
+    bool evaluate(const YacPPToken *begin, const YacPPToken *end, uint32_t line);
+    std::string findInclude(llvm::StringRef name, bool quoted, bool next, int &dir);
+
+    void write(const YacPPToken &token, llvm::raw_ostream &out);
+    void error(uint32_t file, uint32_t line, const std::string &message);
+    void error(const YacPPToken &token, const std::string &message) {
+        error(token.file, token.line, message);
+    }
+
+    std::vector<std::string> m_dirs;
+    std::string m_predefined;
+    std::ostream &m_diagnostics;
+    bool m_failed;
+
+    std::vector<std::string> m_names;
+    llvm::StringMap<uint32_t> m_name_indices;
+    std::vector<Frame> m_frames;
+    // every file entered, macros refer to their text
+    std::vector<std::shared_ptr<const YacTokenizedFile>> m_files;
+    llvm::StringMap<Macro> m_macros;
+    llvm::StringSet<> m_disabled;
+    llvm::StringSet<> m_once;
+    Tokens m_pending;         // read before the files, last token first
+    bool m_isolated;          // m_pending is the whole input
+
+    llvm::BumpPtrAllocator m_allocator;
+    llvm::StringSaver m_saver;
+
+    // output state
+    uint32_t m_out_file, m_out_line;
+    bool m_line_start;
+    YacPPToken m_previous;
+};
+
+#endif
@@ -0,0 +1,181 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "source.h"
+
+YacSourceBuffer::~YacSourceBuffer()
+{
+    release();
+}
+
+bool YacSourceBuffer::allocate(size_t size)
+{
+    release();
+    m_data = static_cast<char *>(malloc(size + 2));
+    if (!m_data)
+        return false;
+    m_size = size;
+    m_capacity = size + 2;
+    m_data[size] = m_data[size + 1] = '\0';
+    return true;
+}
+
+void YacSourceBuffer::release()
+{
+    if (m_data) {
+        if (m_mapped)
+            munmap(m_data, m_capacity);
+        else
+            free(m_data);
+    }
+    m_data = nullptr;
+    m_size = m_capacity = 0;
+    m_mapped = false;
+}
+
+bool YacSourceBuffer::openFile(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        // pipes, character devices etc. cannot be mapped
+        FILE *file = fdopen(fd, "r");
+        if (!file) {
+            close(fd);
+            return false;
+        }
+        bool result = openStream(file);
+        fclose(file);
+        return result;
+    }
+    release();
+    size_t size = static_cast<size_t>(info.st_size);
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t capacity = (size + 2 + page - 1) / page * page;
+    // Reserve zero-filled anonymous pages first and map the file over their
+    // head. The bytes following the end of file are then guaranteed to be
+    // zero, even when the file size is a multiple of the page size.
+    void *base = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    if (size && mmap(base, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, capacity);
+        close(fd);
+        return false;
+    }
+    close(fd);
+    madvise(base, capacity, MADV_SEQUENTIAL);
+    m_data = static_cast<char *>(base);
+    m_size = size;
+    m_capacity = capacity;
+    m_mapped = true;
+    return true;
+}
+
+bool YacSourceBuffer::openStream(FILE *file)
+{
+    release();
+    size_t size = 0, capacity = 64 * 1024;
+    char *data = static_cast<char *>(malloc(capacity + 2));
+    if (!data)
+        return false;
+    size_t count;
+    while ((count = fread(data + size, 1, capacity - size, file)) != 0) {
+        size += count;
+        if (size == capacity) {
+            capacity *= 2;
+            auto grown = static_cast<char *>(realloc(data, capacity + 2));
+            if (!grown) {
+                free(data);
+                return false;
+            }
+            data = grown;
+        }
+    }
+    if (ferror(file)) {
+        free(data);
+        return false;
+    }
+    data[size] = data[size + 1] = '\0';
+    m_data = data;
+    m_size = size;
+    m_capacity = capacity + 2;
+    return true;
+}
+
+void YacSourceBuffer::assign(const char *data, size_t size)
+{
+    if (allocate(size))
+        memcpy(m_data, data, size);
+}
+
+bool YacSourceBuffer::append(const char *data, size_t size)
+{
+    assert(!m_mapped);
+    if (m_size + size + 2 > m_capacity) {
+        auto capacity = std::max<size_t>({m_capacity * 2, m_size + size + 2, 64 * 1024});
+        auto grown = static_cast<char *>(realloc(m_data, capacity));
+        if (!grown)
+            return false;
+        m_data = grown;
+        m_capacity = capacity;
+    }
+    memcpy(m_data + m_size, data, size);
+    m_size += size;
+    m_data[m_size] = m_data[m_size + 1] = '\0';
+    return true;
+}
+
+YacSourceManager::YacSourceManager()
+    : m_offset(0), m_lines{0}, m_files{"<stdin>"} {}
+
+void YacSourceManager::setName(llvm::StringRef name)
+{
+    m_files[0] = name.str();
+}
+
+uint32_t YacSourceManager::addFile(llvm::StringRef file)
+{
+    auto iter = m_file_indices.insert(std::make_pair(file, static_cast<uint32_t>(m_files.size())));
+    if (iter.second)
+        m_files.push_back(file.str());
+    return iter.first->getValue();
+}
+
+void YacSourceManager::lineMarker(unsigned int line, llvm::StringRef file)
+{
+    Marker marker;
+    marker.index = static_cast<uint32_t>(m_lines.size());
+    marker.line = line;
+    marker.file = addFile(file);
+    if (!m_markers.empty() && m_markers.back().index == marker.index)
+        m_markers.back() = marker;
+    else
+        m_markers.push_back(marker);
+}
+
+void YacSourceManager::resolve(uint32_t location, llvm::StringRef &file, unsigned int &line, unsigned int &column) const
+{
+    auto line_iter = std::upper_bound(m_lines.begin(), m_lines.end(), location) - 1;
+    auto index = static_cast<uint32_t>(line_iter - m_lines.begin());
+    column = location - *line_iter + 1;
+    auto marker_iter = std::upper_bound(m_markers.begin(), m_markers.end(), index,
+                                        [](uint32_t index, const Marker &marker) { return index < marker.index; });
+    if (marker_iter == m_markers.begin()) {
+        file = m_files[0];
+        line = index + 1;
+    } else {
+        --marker_iter;
+        file = m_files[marker_iter->file];
+        line = marker_iter->line + (index - marker_iter->index);
+    }
+}
@@ -0,0 +1,129 @@
+#ifndef SOURCE_H_INCLUDE
+#define SOURCE_H_INCLUDE
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The whole translation unit held in memory. Flex scans it in place through
+// `yy_scan_buffer()', which requires the buffer to be writable and terminated
+// by two NUL characters. Regular files are mapped privately (copy-on-write),
+// everything else is read into a heap buffer once.
+class YacSourceBuffer {
+public:
+    YacSourceBuffer() = default;
+    YacSourceBuffer(const YacSourceBuffer &) = delete;
+    YacSourceBuffer &operator = (const YacSourceBuffer &) = delete;
+    ~YacSourceBuffer();
+
+    // return false on error
+    bool openFile(const char *path);
+    bool openStream(FILE *file);
+    void assign(const char *data, size_t size);
+    // Appends to a buffer that is not mapped.
+    // return false on error
+    bool append(const char *data, size_t size);
+
+    char *data() {
+        return m_data;
+    }
+    const char *data() const {
+        return m_data;
+    }
+    // size of the text, the two terminating NUL characters excluded
+    size_t size() const {
+        return m_size;
+    }
+private:
+    bool allocate(size_t size);
+    void release();
+
+    char *m_data = nullptr;
+    size_t m_size = 0;
+    size_t m_capacity = 0;
+    bool m_mapped = false;
+};
+
+// Writes into a YacSourceBuffer, emptied first, as the preprocessor does
+// with the text it expands, so that the text is not copied once more to be
+// scanned.
+class YacSourceBufferStream : public llvm::raw_ostream {
+public:
+    explicit YacSourceBufferStream(YacSourceBuffer &buffer)
+        : m_buffer(buffer) {
+        m_buffer.assign("", 0);
+    }
+    ~YacSourceBufferStream() override {
+        flush();
+    }
+    // return true if some text could not be appended
+    bool failed() const {
+        return m_failed;
+    }
+private:
+    void write_impl(const char *data, size_t size) override {
+        if (!m_buffer.append(data, size))
+            m_failed = true;
+    }
+    uint64_t current_pos() const override {
+        return m_buffer.size();
+    }
+
+    YacSourceBuffer &m_buffer;
+    bool m_failed = false;
+};
+
+class YacTranslationUnit;
+
+// Parses `source' into `unit' with a scanner of its own.
+// return false on syntax error
+bool parseSource(YacTranslationUnit &unit, YacSourceBuffer &source);
+
+// A source location is the byte offset into the scanned buffer. The scanner
+// records where every line starts and the line markers (`# 12 "stdio.h"')
+// left by the preprocessor, so that a location can be resolved to file, line
+// and column only when a diagnostic is actually printed.
+class YacSourceManager {
+public:
+    YacSourceManager();
+
+    // name of the main file, used until the first line marker
+    void setName(llvm::StringRef name);
+
+    /**** Used by the scanner ****/
+    uint32_t location() const {
+        return m_offset;
+    }
+    void advance(unsigned int count) {
+        m_offset += count;
+    }
+    // must be called right after advancing over a newline
+    void newLine() {
+        m_lines.push_back(m_offset);
+    }
+    // the line following the current one is line `line' of `file'
+    void lineMarker(unsigned int line, llvm::StringRef file);
+
+    /**** Used by diagnostics ****/
+    void resolve(uint32_t location, llvm::StringRef &file, unsigned int &line, unsigned int &column) const;
+private:
+    struct Marker {
+        uint32_t index;  // index into m_lines of the first line it applies to
+        uint32_t line;
+        uint32_t file;   // index into m_files
+    };
+    uint32_t addFile(llvm::StringRef file);
+
+    uint32_t m_offset;
+    std::vector<uint32_t> m_lines;
+    std::vector<Marker> m_markers;
+    std::vector<std::string> m_files;
+    llvm::StringMap<uint32_t> m_file_indices;
+};
+
+#endif
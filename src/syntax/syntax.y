@@ -11,23 +11,82 @@
     #include "../ast/statement.h"
     #include "../ast/type.h"
 
-    extern int yylex();
-    extern int yyerror(const char *error_str);
-
     #define GET_ONE_ARGUMENT_MACRO(_1,NAME,...) NAME
     #define GET_TWO_ARGUMENT_MACRO(_1,_2,NAME,...) NAME
-    #define UNSUPPORTED(str) std::cerr << "yac: " << YacSyntaxError("unsupported " str) << std::endl
+    #define UNSUPPORTED(str) diagnostics() << "yac: " << YacSyntaxError("unsupported " str) << std::endl
     #define TODO_PRINT(x) UNSUPPORTED(x)
-    #define EXPRESSION_TODO(x) x = new YacEmptyExpression, UNSUPPORTED("expression")
-    #define STATMENT_TODO(x) x = new YacSyntaxTreeNode, std::cerr << "yac: " << YacSyntaxError("unsupported statement") << std::endl;
+    #define EXPRESSION_TODO(x) x = unit.make<YacEmptyExpression>(), UNSUPPORTED("expression")
+    #define STATMENT_TODO(x) x = unit.make<YacSyntaxTreeNode>(), diagnostics() << "yac: " << YacSyntaxError("unsupported statement") << std::endl;
 %}
 
+%code requires {
+    typedef void *yyscan_t;
+}
+
+%code {
+    int yylex(YYSTYPE *lvalp, yyscan_t scanner);
+
+    static void yyerror(yyscan_t scanner, YacTranslationUnit &unit, const char *error_str) {
+        diagnostics() << "yac: " << YacSyntaxError(error_str) << std::endl;
+    }
+
+    // `declarator' is null for a parameter declared by its type only
+    static YacDeclaration *parameterDeclaration(YacTranslationUnit &unit, int specifiers, YacDeclaratorBuilder *declarator) {
+        if (specifiers & StorageClassSpecifiers & ~Register)
+            diagnostics() << "yac: " << YacSyntaxError("invalid storage class for parameter") << std::endl;
+        auto type = typeFromSpecifiers(unit.types(), specifiers);
+        if (!declarator)
+            return unit.make<YacDeclaration>(castToParameterType(type), nullptr, specifiers & Register);
+        return unit.make<YacDeclaration>(castToParameterType(declarator->type(type)), declarator->identifier(),
+                                         specifiers & Register);
+    }
+
+    static const YacType *typeName(YacTranslationUnit &unit, int specifiers, YacDeclaratorBuilder *declarator) {
+        if (specifiers & StorageClassSpecifiers)
+            diagnostics() << "yac: " << YacSyntaxError("storage class in type name") << std::endl;
+        auto type = typeFromSpecifiers(unit.types(), specifiers);
+        return declarator ? declarator->type(type) : type;
+    }
+
+    // the operand is not evaluated, only its type matters
+    static YacExpression *sizeofExpression(YacTranslationUnit &unit, const YacType *type) {
+        if (!type)
+            return unit.make<YacEmptyExpression>();
+        auto size = sizeOf(type);
+        if (!size) {
+            diagnostics() << "yac: " << YacSyntaxError("invalid application of sizeof to `" + type->name() + '\'') << std::endl;
+            return unit.make<YacEmptyExpression>();
+        }
+        // size_t
+        auto size_type = unit.types().getInteger(YacIntegerType::Long, false);
+        return unit.make<YacConstantExpression>(llvm::ConstantInt::get(size_type->llvmType(), size), size_type);
+    }
+
+    // 0, which is rejected later, if `size' is not a positive integer constant
+    static uint64_t arraySize(YacExpression *size) {
+        if (!size->type)
+            return 0;
+        auto value = llvm::dyn_cast_or_null<llvm::ConstantInt>(size->constant);
+        if (!size->type->isInteger() || !value) {
+            diagnostics() << "yac: " << YacSyntaxError("array size is not an integer constant expression") << std::endl;
+            return 0;
+        }
+        if (size->type->isSigned() && value->isNegative())
+            return 0;
+        return value->getZExtValue();
+    }
+}
+
+%define api.pure full
+%lex-param {yyscan_t scanner}
+%parse-param {yyscan_t scanner} {YacTranslationUnit &unit}
+
 %union
 {
     int token;
-    std::string *string;
-    llvm::Type *type;
-    llvm::Value *value;
+    const YacIdentifier *identifier;
+    const YacType *type;
+    YacConstantExpression *constant;
     YacDeclaratorBuilder *declarator;
     YacDeclaratorBuilderList *declarator_list;
     YacExpression *expression;
@@ -43,8 +102,8 @@
 }
 
 
-%token <string> IDENTIFIER
-%token <value> INTEGER_CONSTANT STRING_LITERAL
+%token <identifier> IDENTIFIER
+%token <constant> INTEGER_CONSTANT STRING_LITERAL
 %token FLOAT_CONSTANT SIZEOF
 %token PTR_OP INC_OP DEC_OP LEFT_OP RIGHT_OP LE_OP GE_OP EQ_OP NE_OP
 %token AND_OP OR_OP MUL_ASSIGN DIV_ASSIGN MOD_ASSIGN ADD_ASSIGN
@@ -57,13 +116,15 @@
 
 %token CASE DEFAULT IF THEN ELSE SWITCH WHILE DO FOR GOTO CONTINUE BREAK RETURN
 
-%type <type> type_specifier
+%type <token> declaration_specifiers specifier type_qualifier_list type_qualifier unary_operator
+%type <type> type_name
 %type <declarator> declarator direct_declarator abstract_declarator direct_abstract_declarator init_declarator
 %type <declarator_list> init_declarator_list
 %type <token> assignment_operator
 %type <expression> expression primary_expression postfix_expression unary_expression multiplicative_expression additive_expression
 %type <expression> shift_expression relational_expression equality_expression and_expression exclusive_or_expression inclusive_or_expression
 %type <expression> logical_and_expression logical_or_expression conditional_expression assignment_expression expression_statement
+%type <expression> cast_expression constant_expression
 %type <expression_list> argument_expression_list
 %type <node> statement jump_statement
 %type <node_list> statement_list
@@ -82,30 +143,33 @@
 
 primary_expression
 	: IDENTIFIER         {
-	    auto value = findInScopes(*$1);
+	    auto value = unit.findInScopes($1);
 	    if (!value) {
-	       std::cerr << "yac: " << YacSyntaxError("unknown identifier `" + *$1 + "\'") << std::endl;
-	       $$ = new YacEmptyExpression;
+	       diagnostics() << "yac: " << YacSyntaxError("unknown identifier `" + $1->str().str() + "\'") << std::endl;
+	       $$ = unit.make<YacEmptyExpression>();
 	    } else
-	        $$ = new YacObjectExpression(value);
+	        $$ = unit.make<YacObjectExpression>(value);
     }
-	| INTEGER_CONSTANT   { $$ = new YacConstantExpression($1); }
+	| INTEGER_CONSTANT   { $$ = $1; }
 	| FLOAT_CONSTANT     { EXPRESSION_TODO($$); } // TODO
-	| STRING_LITERAL     { $$ = new YacConstantExpression($1); }
+	| STRING_LITERAL     { $$ = $1; }
 	| '(' expression ')' { $$ = $2; }
 	;
 
 postfix_expression
 	: primary_expression                                  { $$ = $1; }
-	| postfix_expression '[' expression ']'               { EXPRESSION_TODO($$); } // TODO
-	| postfix_expression '(' ')'                          { $$ = new YacCallExpression($1); }
-	| postfix_expression '(' argument_expression_list ')' { $$ = new YacCallExpression($1, $3); }
+	| postfix_expression '[' expression ']'               {
+	    // `a[i]' is `*(a + i)'
+	    $$ = unit.make<YacIndirectionExpression>(unit.make<YacBinaryExpression>($1, $3, '+'));
+	}
+	| postfix_expression '(' ')'                          { $$ = unit.make<YacCallExpression>($1); }
+	| postfix_expression '(' argument_expression_list ')' { $$ = unit.make<YacCallExpression>($1, $3); }
 	| postfix_expression INC_OP                           { EXPRESSION_TODO($$); } // TODO
 	| postfix_expression DEC_OP                           { EXPRESSION_TODO($$); } // TODO
 	;
 
 argument_expression_list
-	: assignment_expression                               { $$ = new YacExpressionList; $$->push_back($1); }
+	: assignment_expression                               { $$ = unit.make<YacExpressionList>(); $$->push_back($1); }
 	| argument_expression_list ',' assignment_expression  { $$ = $1; $$->push_back($3); }
 	;
 
@@ -113,74 +177,86 @@ unary_expression
 	: postfix_expression              { $$ = $1; }
 	| INC_OP unary_expression         { EXPRESSION_TODO($$); } // TODO
 	| DEC_OP unary_expression         { EXPRESSION_TODO($$); } // TODO
-	| '&' unary_expression            { EXPRESSION_TODO($$); } // TODO
-	| unary_operator unary_expression { EXPRESSION_TODO($$); } // TODO
+	| '&' cast_expression             { $$ = unit.make<YacAddressExpression>($2); }
+	| unary_operator cast_expression  {
+	    if ($1 == '*')
+	        $$ = unit.make<YacIndirectionExpression>($2);
+	    else
+	        $$ = unit.make<YacUnaryExpression>($2, $1);
+	}
+	| SIZEOF unary_expression         { $$ = sizeofExpression(unit, $2->type); }
+	| SIZEOF '(' type_name ')'        { $$ = sizeofExpression(unit, $3); }
 	;
 
 unary_operator
-	: '*'
-	| '+'
-	| '-'
-	| '~'
-	| '!'
+	: '*' { $$ = '*'; }
+	| '+' { $$ = '+'; }
+	| '-' { $$ = '-'; }
+	| '~' { $$ = '~'; }
+	| '!' { $$ = '!'; }
+	;
+
+cast_expression
+	: unary_expression                  { $$ = $1; }
+	| '(' type_name ')' cast_expression { $$ = unit.make<YacCastExpression>($2, $4); }
 	;
 
 multiplicative_expression
-	: unary_expression                               { $$ = $1; }
-	| multiplicative_expression '*' unary_expression { $$ = new YacBinaryExpression($1, $3, '*'); }
-	| multiplicative_expression '/' unary_expression { $$ = new YacBinaryExpression($1, $3, '/'); }
-	| multiplicative_expression '%' unary_expression { $$ = new YacBinaryExpression($1, $3, '%'); }
+	: cast_expression                               { $$ = $1; }
+	| multiplicative_expression '*' cast_expression { $$ = unit.make<YacBinaryExpression>($1, $3, '*'); }
+	| multiplicative_expression '/' cast_expression { $$ = unit.make<YacBinaryExpression>($1, $3, '/'); }
+	| multiplicative_expression '%' cast_expression { $$ = unit.make<YacBinaryExpression>($1, $3, '%'); }
 	;
 
 additive_expression
 	: multiplicative_expression                         { $$ = $1; }
-	| additive_expression '+' multiplicative_expression { $$ = new YacBinaryExpression($1, $3, '+'); }
-	| additive_expression '-' multiplicative_expression { $$ = new YacBinaryExpression($1, $3, '-'); }
+	| additive_expression '+' multiplicative_expression { $$ = unit.make<YacBinaryExpression>($1, $3, '+'); }
+	| additive_expression '-' multiplicative_expression { $$ = unit.make<YacBinaryExpression>($1, $3, '-'); }
 	;
 
 shift_expression
 	: additive_expression                           { $$ = $1; }
-	| shift_expression LEFT_OP additive_expression  { $$ = new YacBinaryExpression($1, $3, LEFT_OP); }
-	| shift_expression RIGHT_OP additive_expression { $$ = new YacBinaryExpression($1, $3, RIGHT_OP); }
+	| shift_expression LEFT_OP additive_expression  { $$ = unit.make<YacBinaryExpression>($1, $3, LEFT_OP); }
+	| shift_expression RIGHT_OP additive_expression { $$ = unit.make<YacBinaryExpression>($1, $3, RIGHT_OP); }
 	;
 
 relational_expression
 	: shift_expression                             { $$ = $1; }
-	| relational_expression '<' shift_expression   { $$ = new YacBinaryExpression($1, $3, '<'); }
-	| relational_expression '>' shift_expression   { $$ = new YacBinaryExpression($1, $3, '>'); }
-	| relational_expression LE_OP shift_expression { $$ = new YacBinaryExpression($1, $3, LE_OP); }
-	| relational_expression GE_OP shift_expression { $$ = new YacBinaryExpression($1, $3, GE_OP); }
+	| relational_expression '<' shift_expression   { $$ = unit.make<YacBinaryExpression>($1, $3, '<'); }
+	| relational_expression '>' shift_expression   { $$ = unit.make<YacBinaryExpression>($1, $3, '>'); }
+	| relational_expression LE_OP shift_expression { $$ = unit.make<YacBinaryExpression>($1, $3, LE_OP); }
+	| relational_expression GE_OP shift_expression { $$ = unit.make<YacBinaryExpression>($1, $3, GE_OP); }
 	;
 
 equality_expression
 	: relational_expression                           { $$ = $1; }
-	| equality_expression EQ_OP relational_expression { $$ = new YacBinaryExpression($1, $3, EQ_OP); }
-	| equality_expression NE_OP relational_expression { $$ = new YacBinaryExpression($1, $3, NE_OP); }
+	| equality_expression EQ_OP relational_expression { $$ = unit.make<YacBinaryExpression>($1, $3, EQ_OP); }
+	| equality_expression NE_OP relational_expression { $$ = unit.make<YacBinaryExpression>($1, $3, NE_OP); }
 	;
 
 and_expression
 	: equality_expression                    { $$ = $1; }
-	| and_expression '&' equality_expression { $$ = new YacBinaryExpression($1, $3, '&'); }
+	| and_expression '&' equality_expression { $$ = unit.make<YacBinaryExpression>($1, $3, '&'); }
 	;
 
 exclusive_or_expression
 	: and_expression                             { $$ = $1; }
-	| exclusive_or_expression '^' and_expression { $$ = new YacBinaryExpression($1, $3, '^'); }
+	| exclusive_or_expression '^' and_expression { $$ = unit.make<YacBinaryExpression>($1, $3, '^'); }
 	;
 
 inclusive_or_expression
 	: exclusive_or_expression                             { $$ = $1; }
-	| inclusive_or_expression '|' exclusive_or_expression { $$ = new YacBinaryExpression($1, $3, '|'); }
+	| inclusive_or_expression '|' exclusive_or_expression { $$ = unit.make<YacBinaryExpression>($1, $3, '|'); }
 	;
 
 logical_and_expression
 	: inclusive_or_expression                               { $$ = $1; }
-	| logical_and_expression AND_OP inclusive_or_expression { $$ = new YacBinaryExpression($1, $3, AND_OP); }
+	| logical_and_expression AND_OP inclusive_or_expression { $$ = unit.make<YacBinaryExpression>($1, $3, AND_OP); }
 	;
 
 logical_or_expression
 	: logical_and_expression                             { $$ = $1; }
-	| logical_or_expression OR_OP logical_and_expression { $$ = new YacBinaryExpression($1, $3, OR_OP); }
+	| logical_or_expression OR_OP logical_and_expression { $$ = unit.make<YacBinaryExpression>($1, $3, OR_OP); }
 	;
 
 conditional_expression
@@ -190,8 +266,8 @@ conditional_expression
 
 assignment_expression
 	: conditional_expression                                     { $$ = $1; }
-	| unary_expression '=' assignment_expression                 { $$ = new YacAssignmentExpression($1, $3); }
-	| unary_expression assignment_operator assignment_expression { $$ = new YacCompoundAssignmentExpression($1, $3, $2); }
+	| unary_expression '=' assignment_expression                 { $$ = unit.make<YacAssignmentExpression>($1, $3); }
+	| unary_expression assignment_operator assignment_expression { $$ = unit.make<YacCompoundAssignmentExpression>($1, $3, $2); }
 	;
 
 assignment_operator
@@ -212,31 +288,63 @@ expression
     | expression ',' assignment_expression { EXPRESSION_TODO($$); } // TODO
     ;
 
+constant_expression
+	: conditional_expression { $$ = $1; }
+	;
+
 declaration
-    : type_specifier ';' { $$ = new YacDeclarationList; }
-    | type_specifier init_declarator_list ';' {
-        auto list = new YacDeclarationList;
-        for (auto declarator: *$2) {
-            auto node = new YacDeclaration(declarator->type($1), declarator->identifier());
-            list->addNode(node);
-            addToTopScope(node);
+    : declaration_specifiers ';' { $$ = unit.make<YacDeclarationList>(); }
+    | declaration_specifiers init_declarator_list ';' {
+        auto list = unit.make<YacDeclarationList>();
+        if ($1 & Typedef)
+            UNSUPPORTED("typedef");
+        else {
+            auto type = typeFromSpecifiers(unit.types(), $1);
+            for (auto declarator: *$2) {
+                auto node = unit.makeDeclaration<YacDeclaration>(declarator->type(type), declarator->identifier(), $1);
+                list->addNode(node);
+                unit.addToTopScope(node);
+            }
         }
         $$ = list;
     }
     ;
 
-type_specifier
-    : VOID   { $$ = llvm::Type::getVoidTy(YacSemanticAnalyzer::context()); }
-    | CHAR   { $$ = llvm::Type::getInt8Ty(YacSemanticAnalyzer::context()); }
-    | SHORT  { $$ = llvm::Type::getInt16Ty(YacSemanticAnalyzer::context()); }
-    | INT    { $$ = llvm::Type::getInt32Ty(YacSemanticAnalyzer::context()); }
-    | LONG   { $$ = llvm::Type::getInt32Ty(YacSemanticAnalyzer::context()); }
-    | FLOAT  { $$ = llvm::Type::getFloatTy(YacSemanticAnalyzer::context()); }
-    | DOUBLE { $$ = llvm::Type::getDoubleTy(YacSemanticAnalyzer::context()); }
+declaration_specifiers
+    : specifier                        { $$ = $1; }
+    | declaration_specifiers specifier { $$ = addSpecifier($1, $2); }
+    ;
+
+specifier
+    : TYPEDEF        { $$ = Typedef; }
+    | EXTERN         { $$ = Extern; }
+    | STATIC         { $$ = Static; }
+    | AUTO           { $$ = Auto; }
+    | REGISTER       { $$ = Register; }
+    | VOID           { $$ = TypeVoid; }
+    | CHAR           { $$ = TypeChar; }
+    | SHORT          { $$ = TypeShort; }
+    | INT            { $$ = TypeInt; }
+    | LONG           { $$ = TypeLong; }
+    | FLOAT          { $$ = TypeFloat; }
+    | DOUBLE         { $$ = TypeDouble; }
+    | SIGNED         { $$ = TypeSigned; }
+    | UNSIGNED       { $$ = TypeUnsigned; }
+    | type_qualifier { $$ = $1; }
+    ;
+
+type_qualifier
+    : CONST    { $$ = QualifierConst; }
+    | VOLATILE { $$ = QualifierVolatile; }
+    ;
+
+type_qualifier_list
+    : type_qualifier                     { $$ = $1; }
+    | type_qualifier_list type_qualifier { $$ = addSpecifier($1, $2); }
     ;
 
 init_declarator_list
-	: init_declarator                          { $$ = new YacDeclaratorBuilderList; $$->push_back($1); }
+	: init_declarator                          { $$ = unit.make<YacDeclaratorBuilderList>(); $$->push_back($1); }
 	| init_declarator_list ',' init_declarator { $$->push_back($3); }
 	;
 
@@ -246,48 +354,57 @@ init_declarator
 	;
 
 declarator
-    : '*' declarator        { $$ = new YacDeclaratorPointer($2); }
-    | direct_declarator     { $$ = $1; }
+    : '*' declarator                     { $$ = unit.make<YacDeclaratorPointer>($2); }
+    | '*' type_qualifier_list declarator { $$ = unit.make<YacDeclaratorPointer>($3, $2); }
+    | direct_declarator                  { $$ = $1; }
     ;
 
 direct_declarator
-	: IDENTIFIER                                            { $$ = new YacDeclaratorIdentifier($1); }
+	: IDENTIFIER                                            { $$ = unit.make<YacDeclaratorIdentifier>($1); }
 	| '(' declarator ')'                                    { $$ = $2; }
-	| direct_declarator '[' ']'                             { $$ = new YacDeclaratorArray($1, 0); }
-	| direct_declarator '[' INTEGER_CONSTANT ']'            { $$ = new YacDeclaratorArray($1, llvm::cast<llvm::ConstantInt>($3)->getLimitedValue()); }
-	| direct_declarator '(' parameter_list ')'              { $$ = new YacDeclaratorFunction($1, $3); }
-	| direct_declarator '(' parameter_list ',' ELLIPSIS ')' { $$ = new YacDeclaratorFunction($1, $3, true); }
-	| direct_declarator '(' ')'                             { $$ = new YacDeclaratorFunction($1); }
+	| direct_declarator '[' ']'                             { $$ = unit.make<YacDeclaratorArray>($1, 0); }
+	| direct_declarator '[' constant_expression ']'         { $$ = unit.make<YacDeclaratorArray>($1, arraySize($3)); }
+	| direct_declarator '(' parameter_list ')'              { $$ = unit.make<YacDeclaratorFunction>($1, $3); }
+	| direct_declarator '(' parameter_list ',' ELLIPSIS ')' { $$ = unit.make<YacDeclaratorFunction>($1, $3, true); }
+	| direct_declarator '(' ')'                             { $$ = unit.make<YacDeclaratorFunction>($1); }
 	;
 
 parameter_list
-	: parameter_declaration                    { $$ = new YacDeclarationList; $$->addNode($1); }
+	: parameter_declaration                    { $$ = unit.make<YacDeclarationList>(); $$->addNode($1); }
 	| parameter_list ',' parameter_declaration { $$ = $1; $$->addNode($3); }
 	;
 
 parameter_declaration
-	: type_specifier declarator          { $$ = new YacDeclaration(castToParameterType($2->type($1)), $2->identifier()); }
-	| type_specifier abstract_declarator { $$ = new YacDeclaration(castToParameterType($2->type($1)), $2->identifier()); }
-	| type_specifier                     { $$ = new YacDeclaration(castToParameterType($1)); }
+	: declaration_specifiers declarator          { $$ = parameterDeclaration(unit, $1, $2); }
+	| declaration_specifiers abstract_declarator { $$ = parameterDeclaration(unit, $1, $2); }
+	| declaration_specifiers                     { $$ = parameterDeclaration(unit, $1, nullptr); }
 	;
 
 abstract_declarator
-	: '*'                                { $$ = new YacDeclaratorPointer(new YacDeclaratorIdentifier); }
-	| '*' abstract_declarator            { $$ = new YacDeclaratorPointer($2); }
-	| direct_abstract_declarator         { $$ = $1; }
+	: '*'                                         { $$ = unit.make<YacDeclaratorPointer>(unit.make<YacDeclaratorIdentifier>()); }
+	| '*' type_qualifier_list                     { $$ = unit.make<YacDeclaratorPointer>(unit.make<YacDeclaratorIdentifier>(), $2); }
+	| '*' abstract_declarator                     { $$ = unit.make<YacDeclaratorPointer>($2); }
+	| '*' type_qualifier_list abstract_declarator { $$ = unit.make<YacDeclaratorPointer>($3, $2); }
+	| direct_abstract_declarator                  { $$ = $1; }
 	;
 
 direct_abstract_declarator
 	: '(' abstract_declarator ')'                                    { $$ = $2; }
-	| '[' ']'                                                        { $$ = new YacDeclaratorArray(new YacDeclaratorIdentifier, 0); }
-	| '[' INTEGER_CONSTANT ']'                                       { $$ = new YacDeclaratorArray(new YacDeclaratorIdentifier, llvm::cast<llvm::ConstantInt>($2)->getLimitedValue()); }
-	| direct_abstract_declarator '[' ']'                             { $$ = new YacDeclaratorArray($1, 0); }
-	| '(' ')'                                                        { $$ = new YacDeclaratorFunction(new YacDeclaratorIdentifier); }
-	| '(' parameter_list ')'                                         { $$ = new YacDeclaratorFunction(new YacDeclaratorIdentifier, $2); }
-	| '(' parameter_list ',' ELLIPSIS ')'                            { $$ = new YacDeclaratorFunction(new YacDeclaratorIdentifier, $2, true); }
-	| direct_abstract_declarator '(' ')'                             { $$ = new YacDeclaratorFunction($1); }
-	| direct_abstract_declarator '(' parameter_list ')'              { $$ = new YacDeclaratorFunction($1, $3); }
-	| direct_abstract_declarator '(' parameter_list ',' ELLIPSIS ')' { $$ = new YacDeclaratorFunction($1, $3, true); }
+	| '[' ']'                                                        { $$ = unit.make<YacDeclaratorArray>(unit.make<YacDeclaratorIdentifier>(), 0); }
+	| '[' constant_expression ']'                                    { $$ = unit.make<YacDeclaratorArray>(unit.make<YacDeclaratorIdentifier>(), arraySize($2)); }
+	| direct_abstract_declarator '[' ']'                             { $$ = unit.make<YacDeclaratorArray>($1, 0); }
+	| direct_abstract_declarator '[' constant_expression ']'         { $$ = unit.make<YacDeclaratorArray>($1, arraySize($3)); }
+	| '(' ')'                                                        { $$ = unit.make<YacDeclaratorFunction>(unit.make<YacDeclaratorIdentifier>()); }
+	| '(' parameter_list ')'                                         { $$ = unit.make<YacDeclaratorFunction>(unit.make<YacDeclaratorIdentifier>(), $2); }
+	| '(' parameter_list ',' ELLIPSIS ')'                            { $$ = unit.make<YacDeclaratorFunction>(unit.make<YacDeclaratorIdentifier>(), $2, true); }
+	| direct_abstract_declarator '(' ')'                             { $$ = unit.make<YacDeclaratorFunction>($1); }
+	| direct_abstract_declarator '(' parameter_list ')'              { $$ = unit.make<YacDeclaratorFunction>($1, $3); }
+	| direct_abstract_declarator '(' parameter_list ',' ELLIPSIS ')' { $$ = unit.make<YacDeclaratorFunction>($1, $3, true); }
+	;
+
+type_name
+	: declaration_specifiers                     { $$ = typeName(unit, $1, nullptr); }
+	| declaration_specifiers abstract_declarator { $$ = typeName(unit, $1, $2); }
 	;
 
 initializer
@@ -311,15 +428,15 @@ statement
 
 compound_statement_start
     : '{' {
-        $$ = new YacScope;
-        pushScope($$);
+        $$ = unit.make<YacScope>();
+        unit.pushScope($$);
     }
 
 compound_statement_end
-    : '}'                                 { $$ = topScope(); popScope(); }
-    | statement_list '}'                  { $$ = topScope(); if ($$) $$->addNode($1); popScope(); }
-    | declaration_list '}'                { $$ = topScope(); if ($$) $$->addNode($1); popScope(); }
-    | declaration_list statement_list '}' { $$ = topScope(); if ($$) { $$->addNode($1); $$->addNode($2); } popScope(); }
+    : '}'                                 { $$ = unit.topScope(); unit.popScope(); }
+    | statement_list '}'                  { $$ = unit.topScope(); if ($$) $$->addNode($1); unit.popScope(); }
+    | declaration_list '}'                { $$ = unit.topScope(); if ($$) $$->addNode($1); unit.popScope(); }
+    | declaration_list statement_list '}' { $$ = unit.topScope(); if ($$) { $$->addNode($1); $$->addNode($2); } unit.popScope(); }
     ;
 
 compound_statement
@@ -336,7 +453,7 @@ declaration_list
 	;
 
 statement_list
-	: statement                { $$ = new YacSyntaxTreeNodeList; $$->addNode($1); }
+	: statement                { $$ = unit.make<YacSyntaxTreeNodeList>(); $$->addNode($1); }
 	| statement_list statement { $$ = $1; $$->addNode($2); }
 	;
 
@@ -360,56 +477,51 @@ iteration_statement
 jump_statement
 	: CONTINUE ';'          { STATMENT_TODO($$); } // TODO
 	| BREAK ';'             { STATMENT_TODO($$); } // TODO
-	| RETURN ';'            { $$ = new YacReturnStatement; }
-	| RETURN expression ';' { $$ = new YacReturnStatement($2); }
+	| RETURN ';'            { $$ = unit.make<YacReturnStatement>(); }
+	| RETURN expression ';' { $$ = unit.make<YacReturnStatement>($2); }
 	;
 
 translation_unit
-	: external_declaration                  {
-	    $$ = root;
-	    for (auto node: $1->children)
-	        $$->addNode(node);
-    }
-	| translation_unit external_declaration {
-	    $$ = $1;
-	    for (auto node: $2->children)
-	        $$->addNode(node);
-    }
+	: external_declaration                  { $$ = unit.root(); unit.addExternalDeclaration($1); }
+	| translation_unit external_declaration { $$ = $1; unit.addExternalDeclaration($2); }
 	;
 
 external_declaration
-	: function_definition { $$ = new YacDeclarationList; $$->addNode($1); }
+	: function_definition { $$ = unit.make<YacDeclarationList>(); $$->addNode($1); }
 	| declaration         { $$ = $1; }
 	;
 
 function_definition_start
-    : type_specifier declarator '{' {
-        auto type = $2->type($1);
-        if (!type->isFunctionTy()) {
-            std::cerr << "yac: " << YacSyntaxError("compound statement after non-function declaration") << std::endl;
+    : declaration_specifiers declarator '{' {
+        auto type = $2->type(typeFromSpecifiers(unit.types(), $1));
+        if (!type->isFunction() || ($1 & (Typedef | Auto | Register))) {
+            diagnostics() << "yac: " << YacSyntaxError(type->isFunction() ? "invalid storage class for function"
+                                                                          : "compound statement after non-function declaration") << std::endl;
             $$ = nullptr;
-            pushScope(nullptr);
+            // as many scopes as the function definition would have
+            unit.pushScope(nullptr);
+            unit.pushScope(nullptr);
         } else {
             auto function = dynamic_cast<YacDeclaratorFunction *>($2);
             assert(function);
-            auto params = new YacScope, body = new YacScope;
-            $$ = new YacFunctionDefinition(llvm::cast<llvm::FunctionType>(type), params, body, $2->identifier());
-            addToTopScope($$);
-            pushScope(params);
+            auto params = unit.make<YacScope>(), body = unit.make<YacScope>();
+            $$ = unit.makeDeclaration<YacFunctionDefinition>(llvm::cast<YacFunctionType>(type), params, body, $2->identifier(), $1);
+            unit.addToTopScope($$);
+            unit.pushScope(params);
             auto args = function->node();
             if (args)
                 for (auto node: args->children) {
                     params->addNode(node);
-                    addToTopScope(node);
+                    unit.addToTopScope(node);
                 }
-            pushScope(body);
+            unit.pushScope(body);
         }
     }
 
 function_definition
     : function_definition_start compound_statement_end {
-        assert($$ == nullptr ? $2 == nullptr : $1->body == $2 && $1->params == topScope());
-        popScope();
+        assert($$ == nullptr ? $2 == nullptr : $1->body == $2 && $1->params == unit.topScope());
+        unit.popScope();
     }
     ;
 
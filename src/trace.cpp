@@ -0,0 +1,169 @@
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+#include <unistd.h>
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include "trace.h"
+
+YacTimeTrace *YacTimeTrace::s_active = nullptr;
+
+YacTimeTrace::YacTimeTrace()
+        : m_start(std::chrono::steady_clock::now()) {}
+
+void YacTimeTrace::start() {
+    if (!s_active)
+        s_active = new YacTimeTrace;
+}
+
+bool YacTimeTrace::finish(std::ostream *report, const std::string &path, std::string &error) {
+    auto trace = s_active;
+    if (!trace)
+        return true;
+    s_active = nullptr;
+    auto elapsed = trace->now();
+    for (auto &event: trace->m_events)
+        if (event.open) {
+            event.duration = elapsed - event.begin;
+            event.open = false;
+        }
+    if (report)
+        trace->writeReport(*report, elapsed);
+    bool success = path.empty() || trace->writeChromeTrace(path, error);
+    delete trace;
+    return success;
+}
+
+uint64_t YacTimeTrace::now() const {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - m_start).count());
+}
+
+size_t YacTimeTrace::begin(llvm::StringRef name, llvm::StringRef detail) {
+    auto time = now();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto thread = m_threads.emplace(std::this_thread::get_id(), m_threads.size()).first->second;
+    m_events.push_back(Event{name.str(), detail.str(), time, 0, thread, true});
+    return m_events.size() - 1;
+}
+
+void YacTimeTrace::end(size_t scope) {
+    auto time = now();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto &event = m_events[scope];
+    event.duration = time - event.begin;
+    event.open = false;
+}
+
+void YacTimeTrace::addTotal(llvm::StringRef name, llvm::StringRef parent, uint64_t duration) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto &total = m_totals[name.str()];
+    total.duration += duration;
+    total.parent = parent.str();
+}
+
+// the time and the number of scopes per name, the threads adding up
+std::map<std::string, YacTimeTrace::Total> YacTimeTrace::totals() const {
+    auto totals = m_totals;
+    for (auto &event: m_events) {
+        auto &total = totals[event.name];
+        total.duration += event.duration;
+        ++total.count;
+    }
+    return totals;
+}
+
+// A row per name, slowest first, the totals within another following it
+// indented, so that the percentages of the top level add up to at most 100.
+void YacTimeTrace::writeReport(std::ostream &out, uint64_t elapsed) const {
+    auto totals = this->totals();
+    typedef std::pair<std::string, Total> Row;
+    std::vector<Row> sorted(totals.begin(), totals.end());
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Row &a, const Row &b) {
+        return a.second.duration > b.second.duration;
+    });
+    auto flags = out.flags();
+    out << std::fixed << std::setprecision(3);
+    out << "yac: time report, " << elapsed / 1000.0 << " ms in total\n";
+    out << "     time (ms)       %   count  scope\n";
+    std::function<void(const std::string &, const std::string &)> write = [&](const std::string &parent,
+                                                                             const std::string &indent) {
+        for (auto &row: sorted) {
+            auto &total = row.second;
+            // a total whose parent never ran goes to the top level
+            bool top = total.parent.empty() || !totals.count(total.parent);
+            if (top ? !parent.empty() : total.parent != parent)
+                continue;
+            out << std::setw(14) << total.duration / 1000.0 << std::setw(8) << std::setprecision(1)
+                << (elapsed ? 100.0 * total.duration / elapsed : 0.0) << std::setprecision(3) << std::setw(8);
+            // a total without scopes has no count
+            if (total.count)
+                out << total.count;
+            else
+                out << '-';
+            out << "  " << indent << row.first << '\n';
+            write(row.first, indent + "  ");
+        }
+    };
+    write("", "");
+    out.flush();
+    out.flags(flags);
+}
+
+static void writeJsonString(llvm::raw_ostream &out, llvm::StringRef text) {
+    out << '"';
+    for (auto c: text) {
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20)
+            out << "\\u00" << llvm::hexdigit((c >> 4) & 0xf, true) << llvm::hexdigit(c & 0xf, true);
+        else
+            out << c;
+    }
+    out << '"';
+}
+
+// The trace event format read by chrome://tracing and Perfetto: a complete
+// event per scope on the row of its thread, then, as clang does, a row per
+// scope name holding its total.
+bool YacTimeTrace::writeChromeTrace(const std::string &path, std::string &error) const {
+    std::error_code err;
+    llvm::raw_fd_ostream out(path, err, llvm::sys::fs::F_Text);
+    if (err) {
+        error = "cannot open time trace file `" + path + '\'';
+        return false;
+    }
+    auto pid = static_cast<int>(getpid());
+    bool first = true;
+    auto event = [&](size_t thread, uint64_t begin, uint64_t duration, llvm::StringRef name) {
+        out << (first ? "\n" : ",\n") << "{\"pid\":" << pid << ",\"tid\":" << thread << ",\"ph\":\"X\",\"ts\":"
+            << begin << ",\"dur\":" << duration << ",\"name\":";
+        writeJsonString(out, name);
+        first = false;
+    };
+    out << "{\"traceEvents\":[";
+    for (auto &scope: m_events) {
+        event(scope.thread, scope.begin, scope.duration, scope.name);
+        if (!scope.detail.empty()) {
+            out << ",\"args\":{\"detail\":";
+            writeJsonString(out, scope.detail);
+            out << '}';
+        }
+        out << '}';
+    }
+    auto thread = m_threads.size();
+    for (auto &total: totals()) {
+        event(thread, 0, total.second.duration, "Total " + total.first);
+        out << ",\"args\":{\"count\":" << total.second.count << "}}";
+        ++thread;
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    out.close();
+    if (out.has_error()) {
+        out.clear_error();
+        error = "cannot write time trace file `" + path + '\'';
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,93 @@
+#ifndef TRACE_H_INCLUDE
+#define TRACE_H_INCLUDE
+
+#include <llvm/ADT/StringRef.h>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The phases of a run timed for --time-report and --time-trace. Nothing is
+// recorded unless a trace is started: a YacTimeScope then finds no active
+// trace and costs the test of a null pointer.
+class YacTimeTrace {
+public:
+    // the trace being recorded, nullptr if none
+    static YacTimeTrace *active() {
+        return s_active;
+    }
+    // Starts recording, before any thread is created.
+    static void start();
+    // Stops recording. Scopes still open, as when the program exits from
+    // `main', end now. The total time of every scope name goes to `report'
+    // if not null, the events to the Chrome trace file `path' if not empty.
+    // return false and set `error' if the trace cannot be written
+    static bool finish(std::ostream *report, const std::string &path, std::string &error);
+
+    // microseconds since the start
+    uint64_t now() const;
+    // return the index passed to end()
+    size_t begin(llvm::StringRef name, llvm::StringRef detail);
+    void end(size_t scope);
+    // Adds `duration' to the total of `name', for time spent in pieces too
+    // small to be events of their own, such as the tokens of the scanner.
+    // The time lies within the scopes of `parent', under which it is reported.
+    void addTotal(llvm::StringRef name, llvm::StringRef parent, uint64_t duration);
+private:
+    struct Event {
+        std::string name, detail;
+        uint64_t begin, duration;
+        size_t thread;
+        bool open;
+    };
+    struct Total {
+        uint64_t duration = 0;
+        size_t count = 0;
+        // the name the total is part of, empty at the top level
+        std::string parent;
+    };
+
+    YacTimeTrace();
+    std::map<std::string, Total> totals() const;
+    void writeReport(std::ostream &out, uint64_t elapsed) const;
+    bool writeChromeTrace(const std::string &path, std::string &error) const;
+
+    std::chrono::steady_clock::time_point m_start;
+    std::mutex m_mutex;
+    std::vector<Event> m_events;
+    // numbered in the order of their first scope
+    std::map<std::thread::id, size_t> m_threads;
+    std::map<std::string, Total> m_totals;
+    static YacTimeTrace *s_active;
+};
+
+// Times the scope it lives in as `name', `detail' telling apart the scopes
+// of a name (the input file, the function...).
+class YacTimeScope {
+public:
+    explicit YacTimeScope(llvm::StringRef name, llvm::StringRef detail = llvm::StringRef())
+            : m_trace(YacTimeTrace::active()) {
+        if (m_trace)
+            m_scope = m_trace->begin(name, detail);
+    }
+    ~YacTimeScope() {
+        end();
+    }
+    // ends the scope before its block does
+    void end() {
+        if (m_trace)
+            m_trace->end(m_scope);
+        m_trace = nullptr;
+    }
+    YacTimeScope(const YacTimeScope &) = delete;
+    YacTimeScope &operator = (const YacTimeScope &) = delete;
+private:
+    YacTimeTrace *m_trace;
+    size_t m_scope = 0;
+};
+
+#endif
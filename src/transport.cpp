@@ -0,0 +1,135 @@
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "transport.h"
+
+static bool writeAll(int fd, const void *data, size_t size) {
+    auto bytes = static_cast<const char *>(data);
+    while (size) {
+        auto written = write(fd, bytes, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool readAll(int fd, void *data, size_t size) {
+    auto bytes = static_cast<char *>(data);
+    while (size) {
+        auto count = read(fd, bytes, size);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        bytes += count;
+        size -= count;
+    }
+    return true;
+}
+
+// the directory, the number of arguments, the arguments and the environment,
+// each ended by a NUL
+static std::string encodeRequest(const YacRequest &request) {
+    std::string data = request.directory + '\0' + std::to_string(request.args.size()) + '\0';
+    for (auto &arg: request.args)
+        data += arg + '\0';
+    for (auto &variable: request.environment)
+        data += variable + '\0';
+    return data;
+}
+
+static bool decodeRequest(const std::string &data, YacRequest &request) {
+    std::vector<std::string> fields;
+    for (size_t begin = 0, end; begin < data.size(); begin = end + 1) {
+        end = data.find('\0', begin);
+        if (end == std::string::npos)
+            return false;
+        fields.emplace_back(data, begin, end - begin);
+    }
+    if (fields.size() < 2)
+        return false;
+    char *end;
+    auto count = std::strtoul(fields[1].c_str(), &end, 10);
+    if (*end || count > fields.size() - 2)
+        return false;
+    request.directory = fields[0];
+    request.args.assign(fields.begin() + 2, fields.begin() + 2 + count);
+    request.environment.assign(fields.begin() + 2 + count, fields.end());
+    return true;
+}
+
+bool sendRequest(int socket, const YacRequest &request) {
+    auto data = encodeRequest(request);
+    // the descriptors go with the size, the data follows
+    uint32_t size = static_cast<uint32_t>(data.size());
+    iovec vector{&size, sizeof(size)};
+    int fds[3] = {0, 1, 2};
+    union {
+        char buffer[CMSG_SPACE(sizeof(fds))];
+        cmsghdr align;
+    } control;
+    std::memset(&control, 0, sizeof(control));
+    msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+    auto header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(fds));
+    std::memcpy(CMSG_DATA(header), fds, sizeof(fds));
+    ssize_t sent;
+    while ((sent = sendmsg(socket, &message, 0)) < 0 && errno == EINTR);
+    return sent == sizeof(size) && writeAll(socket, data.data(), data.size());
+}
+
+bool receiveRequest(int socket, YacRequest &request, int fds[3]) {
+    uint32_t size;
+    iovec vector{&size, sizeof(size)};
+    union {
+        char buffer[CMSG_SPACE(3 * sizeof(int))];
+        cmsghdr align;
+    } control;
+    msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+    ssize_t received;
+    while ((received = recvmsg(socket, &message, MSG_WAITALL)) < 0 && errno == EINTR);
+    auto header = CMSG_FIRSTHDR(&message);
+    if (received != sizeof(size) || !header || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS
+            || header->cmsg_len != CMSG_LEN(3 * sizeof(int)))
+        return false;
+    std::memcpy(fds, CMSG_DATA(header), 3 * sizeof(int));
+    std::string data(size, '\0');
+    if (!readAll(socket, &data[0], size) || !decodeRequest(data, request)) {
+        for (int i = 0; i < 3; ++i)
+            close(fds[i]);
+        return false;
+    }
+    return true;
+}
+
+bool sendStatus(int socket, int status) {
+    uint32_t result = static_cast<uint32_t>(status);
+    return writeAll(socket, &result, sizeof(result));
+}
+
+bool receiveStatus(int socket, int &status) {
+    uint32_t result;
+    if (!readAll(socket, &result, sizeof(result)))
+        return false;
+    status = static_cast<int>(result);
+    return true;
+}
@@ -0,0 +1,27 @@
+#ifndef TRANSPORT_H_INCLUDE
+#define TRANSPORT_H_INCLUDE
+
+#include <string>
+#include <vector>
+
+// A request to the compile server: a yac command line and where it runs.
+// The standard streams of the client travel along with it, so the request
+// reads and writes the client's terminal, pipes and files.
+struct YacRequest {
+    std::string directory;
+    std::vector<std::string> args;          // without the program name
+    std::vector<std::string> environment;   // "NAME=VALUE"
+};
+
+// Sends `request' and the descriptors 0, 1 and 2 over the connected socket.
+bool sendRequest(int socket, const YacRequest &request);
+// Receives a request, `fds' getting its standard streams.
+bool receiveRequest(int socket, YacRequest &request, int fds[3]);
+// Waits for the exit status of the request sent on `socket'. Until then the
+// client may write single bytes to `socket', each the number of a signal to
+// send to the process running the request; closing the connection kills it.
+bool receiveStatus(int socket, int &status);
+// Sends the exit status of a request.
+bool sendStatus(int socket, int status);
+
+#endif
@@ -0,0 +1,41 @@
+/* Calls, pointers, arrays and integer conversions, in straight-line code as
+   the grammar has no branching statements yet. Executed with --jit=tiered
+   and a low --tier-up, the functions called from main run as native code. */
+
+int printf(char *format, ...);
+
+int table[8];
+long total;
+char text[16];
+
+int scale(int x, int factor) {
+	return x * factor + 1;
+}
+
+void store(int *slot, int value) {
+	*slot = value;
+}
+
+long sum(int *values) {
+	return values[0] + values[1] + values[2];
+}
+
+int main() {
+	int local;
+	unsigned int bits;
+	store(&local, scale(6, 7));
+	store(table, local);
+	store(table + 1, scale(local, 2));
+	store(&table[2], -scale(3, 3) / 4);
+	total = sum(table);
+	bits = 0;
+	bits = bits - 1;
+	bits = bits >> 28;
+	text[0] = 'y';
+	text[1] = 'a';
+	text[2] = 'c';
+	text[3] = '\0';
+	printf("%d %d %d %ld\n", table[0], table[1], table[2], total);
+	printf("%u %d %d %s\n", bits, -7 / 2, -7 % 2, text);
+	return local;
+}
@@ -0,0 +1,13 @@
+# Runs the program built by the C compiler and the command of yac on the same
+# input, failing unless both print the same and exit with the same status:
+#   cmake -DEXPECTED=program -DACTUAL="command arguments..." [-DINPUT=file] -P compare.cmake
+separate_arguments(ACTUAL UNIX_COMMAND "${ACTUAL}")
+if (DEFINED INPUT)
+    set(Input INPUT_FILE ${INPUT})
+endif()
+execute_process(COMMAND ${EXPECTED} ${Input} OUTPUT_VARIABLE ExpectedOutput RESULT_VARIABLE ExpectedResult)
+execute_process(COMMAND ${ACTUAL} ${Input} OUTPUT_VARIABLE ActualOutput RESULT_VARIABLE ActualResult)
+if (NOT ExpectedOutput STREQUAL ActualOutput OR NOT ExpectedResult STREQUAL ActualResult)
+    message(FATAL_ERROR "expected, exiting with ${ExpectedResult}:\n${ExpectedOutput}\n"
+            "got, exiting with ${ActualResult}:\n${ActualOutput}")
+endif()
@@ -0,0 +1,6 @@
+/* included twice by preprocess.c, a second definition would not compile */
+#pragma once
+
+int once(int x) {
+	return x + 1;
+}
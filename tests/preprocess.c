@@ -0,0 +1,53 @@
+/* The built-in preprocessor: function-like and variadic macros, `#' and
+   `##', #if arithmetic, include guards and #pragma once. The grammar has no
+   statements to branch with, so every choice is made by the preprocessor. */
+#include "preprocess.h"
+#include "preprocess.h"
+#include "once.h"
+#include "once.h"
+
+int printf(char *format, ...);
+
+#define SQUARE(x) ((x) * (x))
+#define STRING(x) #x
+#define XSTRING(x) STRING(x)
+#define CONCAT(a, b) a ## b
+#define SHOW(format, ...) printf(format, __VA_ARGS__)
+#define EMPTY
+#define VERSION 3
+#define NESTED SQUARE(VERSION + 1)
+
+#if VERSION * 2 + 1 == 7 && defined(SQUARE) && !defined UNDEFINED
+#define ARITHMETIC 1
+#else
+#define ARITHMETIC 0
+#endif
+
+#if (1 << 4) - 1 != 15 || -7 / 2 != -3 || 7 % 3 != 1 || (2 > 1) + 1 != 2
+#error "#if arithmetic"
+#endif
+
+#if 0
+this is not C
+#elif VERSION > 2
+#define BRANCH "elif"
+#else
+#define BRANCH "else"
+#endif
+
+#ifdef VERSION
+#undef VERSION
+#endif
+#ifndef VERSION
+#define VERSION 4
+#endif
+
+int CONCAT(value, 1);
+
+int main() {
+	value1 = SQUARE(1 + 2);
+	SHOW("%d %d %d\n", value1, NESTED, ARITHMETIC);
+	printf("%s %s %s\n", STRING(a + b), XSTRING(VERSION), BRANCH);
+	printf("%d %d %d\n", guarded(VERSION), once(5) EMPTY, __LINE__);
+	return 0;
+}
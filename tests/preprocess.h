@@ -0,0 +1,9 @@
+/* included twice by preprocess.c, a second definition would not compile */
+#ifndef PREPROCESS_H_INCLUDE
+#define PREPROCESS_H_INCLUDE
+
+int guarded(int x) {
+	return x * 2;
+}
+
+#endif
@@ -0,0 +1,21 @@
+/* Short-circuit operators are the only branches the grammar generates: each
+   of them goes one way on every run, for tests/profile.cmake to find in the
+   counts. */
+
+int printf(char *format, ...);
+
+int calls;
+
+int positive(int x) {
+	calls = calls + 1;
+	return x > 0;
+}
+
+int main() {
+	int a;
+	int b;
+	a = positive(1) && positive(2);
+	b = positive(-1) && positive(3);
+	printf("%d %d %d\n", a, b, calls);
+	return 0;
+}
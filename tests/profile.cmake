@@ -0,0 +1,64 @@
+# Runs tests/profile.c under --profile-generate twice, then compiles it with
+# --profile-use, on the profile as written, made stale and scaled past 32
+# bits. The program must print as the C compiler's build every time.
+#   cmake -DYAC=yac -DEXPECTED=program -DSOURCE=profile.c -P profile.cmake
+set(Profile ${CMAKE_CURRENT_BINARY_DIR}/profile-test.profile)
+set(IR ${CMAKE_CURRENT_BINARY_DIR}/profile-test.ll)
+file(REMOVE ${Profile})
+execute_process(COMMAND ${EXPECTED} OUTPUT_VARIABLE ExpectedOutput)
+
+function(run)
+    execute_process(COMMAND ${YAC} ${ARGN} ${SOURCE} OUTPUT_VARIABLE Output ERROR_VARIABLE Error RESULT_VARIABLE Result)
+    list(FIND ARGN -e Execute)
+    if (NOT Result EQUAL 0 OR (Execute GREATER -1 AND NOT Output STREQUAL ExpectedOutput))
+        message(FATAL_ERROR "yac ${ARGN} exited with ${Result}, printing:\n${Output}${Error}")
+    endif()
+    set(Error "${Error}" PARENT_SCOPE)
+endfunction()
+
+function(expect Text Pattern)
+    if (NOT Text MATCHES "${Pattern}")
+        message(FATAL_ERROR "`${Pattern}' not found in:\n${Text}")
+    endif()
+endfunction()
+
+# the second run adds to the counts of the first
+run(-e --profile-generate=${Profile})
+run(-e --profile-generate=${Profile})
+file(READ ${Profile} Counts)
+expect("${Counts}" "function main [0-9]+ 2[ \n]")
+expect("${Counts}" "function positive [0-9]+ 6[ \n]")
+string(REGEX MATCH "function main ([0-9]+)" Main "${Counts}")
+set(Hash ${CMAKE_MATCH_1})
+
+run(-S --emit-llvm -o ${IR} --profile-use=${Profile})
+file(READ ${IR} Code)
+expect("${Code}" "!\"function_entry_count\", i64 2}")
+expect("${Code}" "!\"function_entry_count\", i64 6}")
+expect("${Code}" "!\"branch_weights\", i32 2, i32 0}|!\"branch_weights\", i32 0, i32 2}")
+run(-e -O2 --profile-use=${Profile})
+
+# a changed function keeps none of its counts
+string(REPLACE "function main ${Hash} " "function main 0 " Stale "${Counts}")
+file(WRITE ${Profile} "${Stale}")
+run(-S --emit-llvm -o ${IR} --profile-use=${Profile})
+expect("${Error}" "the profile of `main' does not match its code")
+file(READ ${IR} Code)
+if (Code MATCHES "function_entry_count\", i64 2}")
+    message(FATAL_ERROR "the stale profile of main was applied")
+endif()
+
+# Every branch went the same way on both runs, so once scaled by 2^32 each
+# nonzero count is the largest of its branch: 2^33, which must be divided
+# by 3 to fit the 32-bit weights, 2863311530 printed as a signed i32.
+string(REGEX MATCH "function main [0-9]+ ([0-9 ]+)" Line "${Counts}")
+string(REPLACE " " ";" Numbers "${CMAKE_MATCH_1}")
+set(Scaled "function main ${Hash}")
+foreach(Count ${Numbers})
+    math(EXPR Count "${Count} * 4294967296")
+    set(Scaled "${Scaled} ${Count}")
+endforeach()
+file(WRITE ${Profile} "${Scaled}\n")
+run(-S --emit-llvm -o ${IR} --profile-use=${Profile})
+file(READ ${IR} Code)
+expect("${Code}" "!\"branch_weights\", i32 -1431655766, i32 0}|!\"branch_weights\", i32 0, i32 -1431655766}")